@@ -0,0 +1,360 @@
+//#######################################################################
+// Module:     Calibrate.cpp
+// Descrption: Per channel D/A calibration applied as values are written
+// Creator:    markeby
+// Date:       10/19/2026
+//#######################################################################
+//host libraries
+#include <Arduino.h>
+#ifdef ESP_PLATFORM
+#include <Preferences.h>
+#endif
+
+//ZynthLib
+#include "Calibrate.h"
+#include "I2Cdevices.h"
+#include "Debug.h"
+
+static const char* LabelError = "CAL";
+#define ERROR(args...)    DEBUG_OUT (I2C_DA, DLEVEL_ERROR, ErrorMsg (LabelError, __FUNCTION__, args))
+
+//#######################################################################
+//#######################################################################
+    CALIBRATE_C::CALIBRATE_C ()
+    {
+    _pChannel = nullptr;
+    _Count    = 0;
+    }
+
+//#######################################################################
+// Call after I2cDevices.Begin ().  Every channel starts uncorrected and
+// then picks up whatever was saved.
+//#######################################################################
+void CALIBRATE_C::Begin ()
+    {
+    for ( int z = 0;  z < _Count;  z++ )                // again after a Reconfigure
+        delete[] _pChannel[z].pLut;
+    delete[] _pChannel;
+    _Count    = I2cDevices.GetDeviceCount ();
+    _pChannel = new CAL_CHANNEL_T[_Count];
+    for ( int z = 0;  z < _Count;  z++ )
+        {
+        _pChannel[z].Gain   = CAL_UNITY;
+        _pChannel[z].Offset = 0;
+        _pChannel[z].pLut   = nullptr;
+        }
+    Load ();
+    }
+
+//#######################################################################
+// Channels with no correction are left off the write path entirely
+//#######################################################################
+void CALIBRATE_C::Attach (short device)
+    {
+    CAL_CHANNEL_T& ch = _pChannel[device];
+
+    if ( ch.Gain == CAL_UNITY && ch.Offset == 0 && ch.pLut == nullptr )
+        I2cDevices.SetCalibration (device, nullptr);
+    else
+        I2cDevices.SetCalibration (device, &ch);
+    }
+
+//#######################################################################
+void CALIBRATE_C::Set (short device, float gain, int16_t offset)
+    {
+    if ( device < 0 || device >= _Count || !I2cDevices.IsAnalogOut (device) )
+        return;
+    _pChannel[device].Gain   = lroundf (gain * CAL_UNITY);
+    _pChannel[device].Offset = offset;
+    Attach (device);
+    }
+
+//#######################################################################
+void CALIBRATE_C::Clear (short device)
+    {
+    if ( device < 0 || device >= _Count )
+        return;
+
+    CAL_CHANNEL_T& ch = _pChannel[device];
+    I2cDevices.SetCalibration (device, nullptr);        // off the write path before the LUT goes
+    ch.Gain   = CAL_UNITY;
+    ch.Offset = 0;
+    delete[] ch.pLut;
+    ch.pLut   = nullptr;
+    Attach (device);
+    }
+
+//#######################################################################
+// Fill in where a device is
+//#######################################################################
+void CALIBRATE_C::Address (short device, CAL_RECORD_T& rec)
+    {
+    const I2C_LOCATION_T& loc = I2cDevices.DeviceLocation (device);
+
+    rec.Bus     = loc.Bus;
+    rec.Cluster = loc.Cluster;
+    rec.Slice   = loc.Slice;
+    rec.Port    = loc.Port;
+    rec.Channel = I2cDevices.DeviceChannel (device);
+    }
+
+//#######################################################################
+// The D/A device now at a record's address, -1 if there is none
+//#######################################################################
+short CALIBRATE_C::Find (const CAL_RECORD_T& rec)
+    {
+    CAL_RECORD_T at;
+
+    for ( int z = 0;  z < _Count;  z++ )
+        {
+        if ( !I2cDevices.IsAnalogOut (z) )
+            continue;
+        Address (z, at);
+        if ( at.Bus == rec.Bus && at.Cluster == rec.Cluster && at.Slice == rec.Slice && at.Port == rec.Port && at.Channel == rec.Channel )
+            return (z);
+        }
+    return (-1);
+    }
+
+//#######################################################################
+bool CALIBRATE_C::Restore (const CAL_RECORD_T& rec)
+    {
+    if ( rec.Version != CAL_VERSION )
+        return (false);
+
+    short device = Find (rec);
+    if ( device < 0 )
+        return (false);
+
+    CAL_CHANNEL_T& ch = _pChannel[device];
+    I2cDevices.SetCalibration (device, nullptr);        // off the write path before the LUT goes
+    ch.Gain   = rec.Gain;
+    ch.Offset = rec.Offset;
+    delete[] ch.pLut;
+    ch.pLut   = nullptr;
+    if ( rec.HasLut )
+        {
+        ch.pLut = new int16_t[CAL_LUT_POINTS];
+        memcpy (ch.pLut, rec.Lut, sizeof (rec.Lut));
+        }
+    Attach (device);
+    return (true);
+    }
+
+#ifdef ESP_PLATFORM
+//#######################################################################
+// Preferences key from the channel's address
+//#######################################################################
+static void CalKey (const CAL_RECORD_T& rec, char* key, size_t size)
+    {
+    snprintf (key, size, "%d.%d.%d.%X.%d", rec.Bus, rec.Cluster, rec.Slice, rec.Port, rec.Channel);
+    }
+#endif
+
+//#######################################################################
+bool CALIBRATE_C::Load ()
+    {
+    CAL_RECORD_T rec;
+    int          loaded = 0;
+
+#ifdef ESP_PLATFORM
+    Preferences prefs;
+    char        key[16];
+
+    if ( !prefs.begin (CAL_NAMESPACE, true) )
+        return (false);
+    for ( int z = 0;  z < _Count;  z++ )
+        {
+        if ( !I2cDevices.IsAnalogOut (z) )
+            continue;
+        Address (z, rec);
+        CalKey (rec, key, sizeof (key));
+        if ( prefs.getBytes (key, &rec, sizeof (rec)) == sizeof (rec) && Restore (rec) )
+            loaded++;
+        }
+    prefs.end ();
+#else
+    FILE* fp = fopen (CAL_NAMESPACE ".bin", "rb");
+
+    if ( fp == nullptr )
+        return (false);
+    while ( fread (&rec, sizeof (rec), 1, fp) == 1 )
+        {
+        if ( Restore (rec) )
+            loaded++;
+        }
+    fclose (fp);
+#endif
+    return (loaded > 0);
+    }
+
+//#######################################################################
+// Writes every corrected channel and drops anything stored before
+//#######################################################################
+bool CALIBRATE_C::Save ()
+    {
+    CAL_RECORD_T rec;
+    bool         ok = true;
+
+#ifdef ESP_PLATFORM
+    Preferences prefs;
+    char        key[16];
+
+    if ( !prefs.begin (CAL_NAMESPACE, false) )
+        return (false);
+    prefs.clear ();
+#else
+    FILE* fp = fopen (CAL_NAMESPACE ".bin", "wb");
+
+    if ( fp == nullptr )
+        return (false);
+#endif
+    for ( int z = 0;  z < _Count;  z++ )
+        {
+        CAL_CHANNEL_T& ch = _pChannel[z];
+
+        if ( ch.Gain == CAL_UNITY && ch.Offset == 0 && ch.pLut == nullptr )
+            continue;
+        memset (&rec, 0, sizeof (rec));
+        rec.Version = CAL_VERSION;
+        Address (z, rec);
+        rec.Gain    = ch.Gain;
+        rec.Offset  = ch.Offset;
+        rec.HasLut  = ( ch.pLut != nullptr );
+        if ( ch.pLut )
+            memcpy (rec.Lut, ch.pLut, sizeof (rec.Lut));
+#ifdef ESP_PLATFORM
+        CalKey (rec, key, sizeof (key));
+        ok &= ( prefs.putBytes (key, &rec, sizeof (rec)) == sizeof (rec) );
+#else
+        ok &= ( fwrite (&rec, sizeof (rec), 1, fp) == 1 );
+#endif
+        }
+#ifdef ESP_PLATFORM
+    prefs.end ();
+#else
+    fclose (fp);
+#endif
+    if ( !ok )
+        ERROR ("Calibration store failed");
+    return (ok);
+    }
+
+//#######################################################################
+bool CALIBRATE_C::Measure (short adc, float& value)
+    {
+    int32_t sum = 0;
+    int16_t raw;
+
+    for ( int z = 0;  z < CAL_SAMPLES;  z++ )
+        {
+        if ( !I2cDevices.MeasureAtoD (adc, raw) )
+            return (false);
+        sum += raw;
+        }
+    value = (float)sum / CAL_SAMPLES;
+    return (true);
+    }
+
+//#######################################################################
+// Steps the raw D/A through every LUT node while an A/D channel reads
+// the output back.  scale is the A/D counts an ideal channel gives per
+// D/A count.  A straight line fit sets gain and offset, and with lut
+// the remaining error at each node is kept as well.  Floats are only
+// used here, never on the write path.  Blocking, so not from the loop.
+//#######################################################################
+bool CALIBRATE_C::AutoCalibrate (short dac, short adc, float scale, bool lut)
+    {
+    float code[CAL_LUT_POINTS];
+    float meas[CAL_LUT_POINTS];
+    float sx = 0, sy = 0, sxx = 0, sxy = 0;
+    int   n  = CAL_LUT_POINTS;
+
+    if ( dac < 0 || dac >= _Count || adc < 0 || adc >= _Count || scale <= 0 )
+        return (false);
+    if ( !I2cDevices.IsAnalogOut (dac) || !I2cDevices.IsAnalogIn (adc) )
+        return (false);
+
+    I2cDevices.SetCalibration (dac, nullptr);           // measure the channel as it really is
+    for ( int z = 0;  z < n;  z++ )
+        {
+        code[z] = min (z << CAL_LUT_SHIFT, CAL_DAC_MAX);
+        I2cDevices.D2AnalogDirect (dac, code[z]);
+        I2cDevices.FlushDevice (dac);                   // now, not when the bus budget allows
+        delay (CAL_SETTLE_MS);
+        if ( !Measure (adc, meas[z]) )
+            {
+            ERROR ("No reading from A/D %d", adc);
+            Attach (dac);
+            return (false);
+            }
+        meas[z] /= scale;                               // in ideal D/A counts
+        sx  += code[z];
+        sy  += meas[z];
+        sxx += code[z] * code[z];
+        sxy += code[z] * meas[z];
+        }
+    I2cDevices.D2AnalogDirect (dac, 0);
+    I2cDevices.FlushDevice (dac);
+
+    // meas = a * code + b, so the code for a value v is (v - b) / a
+    float a = ((n * sxy) - (sx * sy)) / ((n * sxx) - (sx * sx));
+    float b = (sy - (a * sx)) / n;
+    if ( !(a > 0.0f) )
+        {
+        ERROR ("D/A %d does not track A/D %d", dac, adc);
+        Attach (dac);
+        return (false);
+        }
+
+    CAL_CHANNEL_T& ch = _pChannel[dac];
+    ch.Gain   = lroundf (CAL_UNITY / a);
+    ch.Offset = lroundf (-b / a);
+    delete[] ch.pLut;
+    ch.pLut   = nullptr;
+
+    if ( lut )
+        {
+        ch.pLut = new int16_t[CAL_LUT_POINTS];
+        for ( int zn = 0;  zn < n;  zn++ )
+            {
+            // the value the straight line puts on this node and the
+            // code the measurements say it really needs
+            float v1 = zn << CAL_LUT_SHIFT;
+            float v  = (a * v1) + b;
+            int   zs = 0;
+
+            while ( zs < n - 2 && meas[zs + 1] < v )
+                zs++;
+            float span = meas[zs + 1] - meas[zs];
+            float want = ( span > 0 ) ? code[zs] + ((v - meas[zs]) * (code[zs + 1] - code[zs]) / span) : code[zs];
+            ch.pLut[zn] = lroundf (want - v1);
+            }
+        }
+    Attach (dac);
+    return (true);
+    }
+
+//#######################################################################
+void CALIBRATE_C::Dump ()
+    {
+    printf ("\n  D/A calibration:\n");
+    for ( int z = 0;  z < _Count;  z++ )
+        {
+        CAL_CHANNEL_T& ch = _pChannel[z];
+
+        if ( ch.Gain == CAL_UNITY && ch.Offset == 0 && ch.pLut == nullptr )
+            continue;
+        printf ("    %4d  gain %8.5f  offset %5d", z, (float)ch.Gain / CAL_UNITY, ch.Offset);
+        if ( ch.pLut )
+            {
+            printf ("  lut");
+            for ( int zn = 0;  zn < CAL_LUT_POINTS;  zn++ )
+                printf (" %d", ch.pLut[zn]);
+            }
+        printf ("\n");
+        }
+    }
+
+//#######################################################################
+CALIBRATE_C Calibration;
@@ -0,0 +1,92 @@
+//#######################################################################
+// Module:     Calibrate.h
+// Descrption: Per channel D/A calibration applied as values are written
+// Creator:    markeby
+// Date:       10/19/2026
+//#######################################################################
+#pragma once
+
+#define CAL_DAC_MAX         4095        // full scale of the 12 bit D/A
+#define CAL_LUT_SHIFT       8           // LUT node spacing of 256 counts...
+#define CAL_LUT_POINTS      ((CAL_DAC_MAX >> CAL_LUT_SHIFT) + 2)    // ...so 17 nodes cover 0 to 4096
+#define CAL_UNITY           65536       // Q16 gain of one
+#define CAL_SETTLE_MS       5           // D/A and output stage settling before a measurement
+#define CAL_SAMPLES         4           // A/D readings averaged per point
+#define CAL_NAMESPACE       "zcal"      // NVS namespace, or file name on a host build
+
+//#######################################################################
+// All integer so a write costs a multiply, a shift and with a LUT one
+// interpolation between nodes.
+//#######################################################################
+typedef struct CAL_CHANNEL_S
+    {
+    int32_t     Gain;           // Q16, CAL_UNITY is no change
+    int16_t     Offset;         // D/A counts added after the gain
+    int16_t*    pLut;           // residual counts at each LUT node of the corrected value, nullptr for none
+
+    inline uint16_t Apply (uint16_t value) const
+        {
+        if ( value > CAL_DAC_MAX )
+            value = CAL_DAC_MAX;
+        int32_t v = ((value * Gain) >> 16) + Offset;
+        if ( pLut )
+            {
+            v = ( v < 0 ) ? 0 : (( v > CAL_DAC_MAX ) ? CAL_DAC_MAX : v);
+            int     i = v >> CAL_LUT_SHIFT;
+            int32_t f = v & ((1 << CAL_LUT_SHIFT) - 1);
+            v += pLut[i] + (((pLut[i + 1] - pLut[i]) * f) >> CAL_LUT_SHIFT);
+            }
+        return (( v < 0 ) ? 0 : (( v > CAL_DAC_MAX ) ? CAL_DAC_MAX : v));
+        }
+    } CAL_CHANNEL_T;
+
+//#######################################################################
+// Stored form of one channel.  It is keyed by where the channel is so
+// the correction stays with its board when device numbers move.
+//#######################################################################
+#define CAL_VERSION         2
+
+typedef struct
+    {
+    uint16_t    Version;
+    int8_t      Bus;
+    int8_t      Cluster;        // -1 when not behind a mux
+    int8_t      Slice;
+    uint8_t     Port;
+    uint8_t     Channel;        // D/A channel on the board
+    uint8_t     HasLut;
+    int32_t     Gain;
+    int16_t     Offset;
+    int16_t     Lut[CAL_LUT_POINTS];
+    } CAL_RECORD_T;
+
+//#######################################################################
+class CALIBRATE_C
+    {
+private:
+    CAL_CHANNEL_T*  _pChannel;          // one per I2C device, D/A channels only used
+    int             _Count;
+
+    void Attach             (short device);
+    void Address            (short device, CAL_RECORD_T& rec);
+    short Find              (const CAL_RECORD_T& rec);
+    bool Restore            (const CAL_RECORD_T& rec);
+    bool Measure            (short adc, float& value);
+
+public:
+         CALIBRATE_C        (void);
+    void Begin              (void);
+    void Set                (short device, float gain, int16_t offset);
+    void Clear              (short device);
+    bool Load               (void);
+    bool Save               (void);
+    bool AutoCalibrate      (short dac, short adc, float scale, bool lut);
+    void Dump               (void);
+
+    //#######################################################################
+    const CAL_CHANNEL_T* Get (short device)
+        { return (( device >= 0 && device < _Count ) ? &_pChannel[device] : nullptr); }
+    };
+
+//#######################################################################
+extern CALIBRATE_C Calibration;
@@ -0,0 +1,104 @@
+//#######################################################################
+// Module:     Crumbs.cpp
+// Descrption: Breadcrumbs kept in RTC memory across a reset
+// Creator:    markeby
+// Date:       10/19/2026
+//#######################################################################
+//host libraries
+#include <Arduino.h>
+
+//ZynthLib
+#include "Crumbs.h"
+#include "I2Cdevices.h"
+
+RTC_NOINIT_ATTR static CRUMB_BLOCK_T crumbBlock;
+
+static const char  crumbPhase[] = { 'B', 'E', 'C' };
+
+//#######################################################################
+//#######################################################################
+    CRUMBS_C::CRUMBS_C ()
+    {
+    _pBlock     = nullptr;
+    _HaveSaved  = false;
+    _LastSample = 0;
+    memset (&_Saved, 0, sizeof (_Saved));
+    }
+
+//#######################################################################
+void CRUMBS_C::Begin ()
+    {
+    CRUMB_BLOCK_T& blk = crumbBlock;
+
+    _HaveSaved = ( blk.Magic == CRUMB_MAGIC && blk.Check == (CRUMB_MAGIC ^ blk.Boots) );
+    if ( _HaveSaved )
+        _Saved = blk;
+    else
+        blk.Boots = 0;
+
+    uint32_t boots = blk.Boots + 1;
+
+    memset (&blk, 0, sizeof (blk));
+    blk.Magic   = CRUMB_MAGIC;
+    blk.Boots   = boots;
+    blk.Check   = CRUMB_MAGIC ^ boots;
+    _pBlock     = &blk;
+    _LastSample = micros ();
+    Tracer.Crumbs (blk.Point, &blk.PointHead);
+    }
+
+//#######################################################################
+// The I2C counters only change on the bus task and are read without
+// the lock, a count may be one behind.
+//#######################################################################
+void CRUMBS_C::Sample (uint32_t now)
+    {
+    I2C_COUNTERS_T total;
+
+    _LastSample = now;
+    I2cDevices.ErrorTotals (total);
+    _pBlock->Uptime       = millis ();
+    _pBlock->Transactions = total.Transactions;
+    _pBlock->NackAddress  = total.NackAddress;
+    _pBlock->NackData     = total.NackData;
+    _pBlock->Timeouts     = total.Timeouts;
+    _pBlock->OtherErrors  = total.OtherErrors;
+    _pBlock->Quarantines  = total.Quarantines;
+    }
+
+//#######################################################################
+// What the last run was doing when it went down.  Trace points are timed
+// from the start of the loop that never finished.
+//#######################################################################
+void CRUMBS_C::Report ()
+    {
+    if ( !_HaveSaved )
+        return;
+
+    CRUMB_BLOCK_T& blk   = _Saved;
+    float          mhz   = ESP.getCpuFreqMHz ();
+    uint32_t       loops = ( blk.LoopHead < CRUMB_LOOPS ) ? blk.LoopHead : CRUMB_LOOPS;
+    uint32_t       count = ( blk.PointHead < TRACE_CRUMB_DEPTH ) ? blk.PointHead : TRACE_CRUMB_DEPTH;
+
+    printf ("  Breadcrumbs from run %u, up %.1f Sec after %u loops\n", blk.Boots, blk.Uptime * 0.001, blk.LoopHead);
+    printf ("    envelopes active %d\n", blk.Active);
+    printf ("    I2C %u transactions   nack address %u   nack data %u   timeouts %u   other %u   quarantines %u\n",
+            blk.Transactions, blk.NackAddress, blk.NackData, blk.Timeouts, blk.OtherErrors, blk.Quarantines);
+    printf ("    last loop times in uSec, oldest first:");
+    for ( uint32_t z = 0;  z < loops;  z++ )
+        printf ("%s%u", ( z % 8 ) ? "  " : "\n      ", blk.Loop[(blk.LoopHead - loops + z) & (CRUMB_LOOPS - 1)]);
+    printf ("\n    last trace points, uSec into the last loop by the loop core's clock, then the core:\n");
+    for ( uint32_t z = 0;  z < count;  z++ )
+        {
+        TRACE_RECORD_T& rec = blk.Point[(blk.PointHead - count + z) & (TRACE_CRUMB_DEPTH - 1)];
+
+        if ( rec.Type > (uint8_t)TRACE_TYPE::COUNTER )
+            continue;
+        printf ("      %10.1f  %d  %-12s %c  %d\n", (int32_t)(rec.Cycles - blk.LoopCycles) / mhz, ( rec.Id & TRACE_CORE_BIT ) ? 1 : 0, Tracer.Name (rec.Id), crumbPhase[rec.Type],
+                ( rec.Type == (uint8_t)TRACE_TYPE::COUNTER ) ? rec.Value : rec.Arg);
+        }
+    printf ("\n");
+    }
+
+//#######################################################################
+CRUMBS_C Breadcrumbs;
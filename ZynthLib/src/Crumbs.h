@@ -0,0 +1,84 @@
+//#######################################################################
+// Module:     Crumbs.h
+// Descrption: Breadcrumbs kept in RTC memory across a reset
+// Creator:    markeby
+// Date:       10/19/2026
+//#######################################################################
+#pragma once
+#include "Trace.h"
+
+#define CRUMB_LOOPS         32          // loop times kept.  Must be a power of two
+#define CRUMB_SAMPLE_US     100000      // uSec between samples of the I2C error counters
+#define CRUMB_MAGIC         0x5A43524D  // "ZCRM"
+
+//#######################################################################
+// Lives in RTC memory which is left alone by every reset but power on.
+// Check is the magic mixed with the boot count so garbage after power
+// on is not taken for breadcrumbs.
+//#######################################################################
+typedef struct
+    {
+    uint32_t        Magic;
+    uint32_t        Boots;                      // resets with the block intact
+    uint32_t        Check;
+    uint32_t        LoopHead;                   // loops ever recorded
+    uint32_t        Loop[CRUMB_LOOPS];          // uSec of each loop
+    uint32_t        LoopCycles;                 // cycle counter as the last loop started
+    uint32_t        PointHead;                  // trace points ever recorded
+    TRACE_RECORD_T  Point[TRACE_CRUMB_DEPTH];
+    uint16_t        Active;                     // envelopes running in the last loop
+    uint32_t        Uptime;                     // mSec at the last sample
+    uint32_t        Transactions;               // I2C counters at the last sample
+    uint32_t        NackAddress;
+    uint32_t        NackData;
+    uint32_t        Timeouts;
+    uint32_t        OtherErrors;
+    uint32_t        Quarantines;
+    } CRUMB_BLOCK_T;
+
+//#######################################################################
+// Call Begin () first thing in setup ().  It keeps what the last run
+// left behind for BootDebug () to report and starts recording again.
+//#######################################################################
+class CRUMBS_C
+    {
+private:
+    CRUMB_BLOCK_T*  _pBlock;                    // nullptr until Begin
+    CRUMB_BLOCK_T   _Saved;                     // from before the reset
+    bool            _HaveSaved;
+    uint32_t        _LastSample;                // micros () of the last sample
+
+    void Sample             (uint32_t now);
+
+public:
+         CRUMBS_C           (void);
+    void Begin              (void);
+    void Report             (void);
+
+    //#######################################################################
+    // From ZyTime.Loop () with the time of the loop just finished
+    //#######################################################################
+    void LoopTime (uint32_t usec, uint32_t now)
+        {
+        if ( _pBlock == nullptr )
+            return;
+        _pBlock->Loop[_pBlock->LoopHead++ & (CRUMB_LOOPS - 1)] = usec;
+        _pBlock->LoopCycles = ESP.getCycleCount ();
+        if ( now - _LastSample >= CRUMB_SAMPLE_US )
+            Sample (now);
+        }
+
+    //#######################################################################
+    void Active (uint16_t count)
+        {
+        if ( _pBlock != nullptr )
+            _pBlock->Active = count;
+        }
+
+    //#######################################################################
+    bool HaveSaved (void)
+        { return (_HaveSaved); }
+    };
+
+//#######################################################################
+extern CRUMBS_C Breadcrumbs;
@@ -8,8 +8,24 @@
 #include <Streaming.h>
 #include <vector>
 #include "Debug.h"
+#include "Crumbs.h"
 using namespace std;
 
+//#######################################################################
+// Runtime levels start with only errors reported
+//#######################################################################
+uint8_t DebugRuntimeLevel[(int)DMODULE::COUNT] =
+    {
+    DLEVEL_ERROR, DLEVEL_ERROR, DLEVEL_ERROR, DLEVEL_ERROR, DLEVEL_ERROR, DLEVEL_ERROR
+    };
+
+//#######################################################################
+void DebugSetLevel (DMODULE module, uint8_t level)
+    {
+    uint8_t max = DebugCompiledLevel (module);
+    DebugRuntimeLevel[(int)module] = ( level < max ) ? level : max;
+    }
+
 //#######################################################################
 const String vFormat (const char *const zcFormat, ...)
     {
@@ -50,6 +66,7 @@ const String vsFormat (const char *const zcFormat, va_list args)
     return (String (zc.data (), iLen));
     }
 
+#ifndef DEBUG_DEFERRED
 //#######################################################################
 void DebugMsg (const char* label, uint8_t index, const char *const fmt, ...)
     {
@@ -77,7 +94,7 @@ void DebugMsgN (const char* label, uint8_t index, String name,  const char *cons
     }
 
 //#######################################################################
-void DebugMsgF (const char* label, uint8_t index, String name, char* flag, const char *const fmt, ...)
+void DebugMsgF (const char* label, uint8_t index, String name, const char* flag, const char *const fmt, ...)
     {
     va_list ap;
     va_start (ap, fmt);
@@ -97,14 +114,353 @@ void ErrorMsg (const char* label, const char* func, const char* const fmt, ...)
     Serial << str << endl;
     }
 
+#else
+//#######################################################################
+// Deferred debug output
+//#######################################################################
+#define DEBUG_TASK_PERIOD   10          // mSec between drains of the ring
+#define DEBUG_LINE_SIZE     256
+
+// Counters and rate limits are updated without locks.  A race between
+// the two cores can only loosen a limit by a message or two.
+static DEBUG_RECORD_T           debugRing[DEBUG_RING_DEPTH];
+static std::atomic<uint32_t>    debugHead;
+static uint32_t                 debugTail;
+static std::atomic<bool>        debugFlushing;
+static std::atomic<bool>        debugTaskStarted;
+static uint16_t                 debugRateCount  = DEBUG_RATE_COUNT;
+static uint16_t                 debugRatePeriod = DEBUG_RATE_PERIOD;
+static std::atomic<uint32_t>    debugRecorded;
+static std::atomic<uint32_t>    debugPrinted;
+static std::atomic<uint32_t>    debugOverflow;
+static std::atomic<uint32_t>    debugLimited;
+static uint32_t                 debugReported;
+
+//#######################################################################
+// Rate limit for one call site.  DEBUG_OUT keeps a site for each of
+// its expansions so messages sharing a format string do not share
+// a limit.
+//#######################################################################
+bool DebugAllow (DEBUG_SITE_T& site)
+    {
+    if ( debugRateCount == 0 )
+        return (true);
+
+    uint32_t now = millis ();
+    if ( (now - site.Start) >= debugRatePeriod )
+        {
+        site.Start = now;
+        site.Count = 0;
+        }
+    if ( site.Count++ < debugRateCount )
+        return (true);
+    debugLimited++;
+    return (false);
+    }
+
 //#######################################################################
-char* ErrorStringI2C (int err)
+// Bounded multi-producer ring.  A slot's sequence is kept relative to
+// its index so the zero initialized ring is ready before any
+// constructors run:
+//      free  when  Seq == lap
+//      ready when  Seq == lap + 1
+//#######################################################################
+DEBUG_RECORD_T* DebugReserve (uint32_t& pos)
     {
-    static char* e1 = "data too long to fit in transmit buffer";
-    static char* e2 = "Received NACK on transmit of address";
-    static char* e3 = "received NACK on transmit of data";
-    static char* e4 =  "other error";
-    static char* e5 = "timeout";
+    if ( !debugTaskStarted.load (std::memory_order_relaxed) )
+        DebugStartTask ();
+
+    pos = debugHead.load (std::memory_order_relaxed);
+    for ( ;; )
+        {
+        DEBUG_RECORD_T& rec  = debugRing[pos & (DEBUG_RING_DEPTH - 1)];
+        int32_t         diff = (int32_t)(rec.Seq.load (std::memory_order_acquire) - (pos & ~(DEBUG_RING_DEPTH - 1)));
+
+        if ( diff == 0 )
+            {
+            if ( debugHead.compare_exchange_weak (pos, pos + 1, std::memory_order_relaxed) )
+                {
+                rec.Time = micros ();
+                return (&rec);
+                }
+            }
+        else if ( diff < 0 )
+            {
+            debugOverflow++;
+            return (nullptr);
+            }
+        else
+            pos = debugHead.load (std::memory_order_relaxed);
+        }
+    }
+
+//#######################################################################
+void DebugCommit (DEBUG_RECORD_T* rec, uint32_t pos)
+    {
+    rec->Seq.store ((pos & ~(DEBUG_RING_DEPTH - 1)) + 1, std::memory_order_release);
+    debugRecorded++;
+    }
+
+//#######################################################################
+uint8_t DebugText (DEBUG_RECORD_T& rec, const char* str)
+    {
+    uint8_t at = rec.TextUsed;
+
+    if ( at >= DEBUG_TEXT_SIZE )
+        return (DEBUG_NO_TEXT);
+    if ( str == nullptr )
+        str = "(null)";
+    while ( *str && rec.TextUsed < (DEBUG_TEXT_SIZE - 1) )
+        rec.Text[rec.TextUsed++] = *str++;
+    rec.Text[rec.TextUsed++] = 0;
+    return (at);
+    }
+
+//#######################################################################
+static const char* DebugTextAt (DEBUG_RECORD_T& rec, uint8_t at)
+    {
+    return (( at < DEBUG_TEXT_SIZE ) ? &rec.Text[at] : "");
+    }
+
+//#######################################################################
+// Rebuild the message from the format string and the recorded
+// arguments one conversion at a time.  Length modifiers in the format
+// are replaced by the type that was actually recorded.
+//#######################################################################
+static int DebugFormat (DEBUG_RECORD_T& rec, char* out, int size)
+    {
+    const char* fmt  = rec.Format;
+    int         len  = 0;
+    int         argn = 0;
+    char        spec[24];
+
+    while ( *fmt && len < (size - 1) )
+        {
+        if ( *fmt != '%' )
+            {
+            out[len++] = *fmt++;
+            continue;
+            }
+        if ( fmt[1] == '%' )
+            {
+            out[len++] = '%';
+            fmt += 2;
+            continue;
+            }
+
+        // Flags and widths may use all but the room for "ll", the
+        // conversion and the terminator.  A longer spec ends the message.
+        int  sl    = 0;
+        int  limit = sizeof (spec) - 4;
+        bool fit   = true;
+        spec[sl++] = *fmt++;
+        while ( *fmt && strchr ("-+ #0123456789.*", *fmt) )
+            {
+            if ( *fmt == '*' )
+                {
+                int w = ( argn < rec.Count ) ? (int)rec.Arg[argn++].I : 0;
+                int n = snprintf (&spec[sl], limit - sl, "%d", w);
+                if ( n < 0 || n >= (limit - sl) )
+                    {
+                    fit = false;
+                    break;
+                    }
+                sl += n;
+                fmt++;
+                }
+            else if ( sl < limit - 1 )
+                spec[sl++] = *fmt++;
+            else
+                {
+                fit = false;
+                break;
+                }
+            }
+        if ( !fit )
+            break;
+        while ( *fmt && strchr ("hlLqjzt", *fmt) )
+            fmt++;
+        char conv = *fmt;
+        if ( conv == 0 )
+            break;
+        fmt++;
+
+        int n;
+        int room = size - len;
+        if ( argn >= rec.Count )
+            n = snprintf (&out[len], room, "<?>");
+        else
+            {
+            DEBUG_ARG_T& arg  = rec.Arg[argn];
+            uint8_t      type = rec.Type[argn++];
+
+            switch ( conv )
+                {
+                case 'd':
+                case 'i':
+                case 'u':
+                case 'x':
+                case 'X':
+                case 'o':
+                    spec[sl++] = 'l';
+                    spec[sl++] = 'l';
+                    spec[sl++] = conv;
+                    spec[sl]   = 0;
+                    n = snprintf (&out[len], room, spec, ( type == DARG_DOUBLE ) ? (long long)arg.D : (long long)arg.I);
+                    break;
+                case 'c':
+                    spec[sl++] = conv;
+                    spec[sl]   = 0;
+                    n = snprintf (&out[len], room, spec, (int)arg.I);
+                    break;
+                case 'f':
+                case 'F':
+                case 'e':
+                case 'E':
+                case 'g':
+                case 'G':
+                case 'a':
+                case 'A':
+                    spec[sl++] = conv;
+                    spec[sl]   = 0;
+                    n = snprintf (&out[len], room, spec, ( type == DARG_DOUBLE ) ? arg.D : ( type == DARG_INT ) ? (double)arg.I : (double)arg.U);
+                    break;
+                case 's':
+                    spec[sl++] = conv;
+                    spec[sl]   = 0;
+                    n = snprintf (&out[len], room, spec, ( type == DARG_STRING ) ? DebugTextAt (rec, arg.T) : "<?>");
+                    break;
+                case 'p':
+                    spec[sl++] = conv;
+                    spec[sl]   = 0;
+                    n = snprintf (&out[len], room, spec, arg.P);
+                    break;
+                default:
+                    n = 0;
+                    break;
+                }
+            }
+        if ( n > 0 )
+            len += ( n < room ) ? n : (room - 1);
+        }
+    out[len] = 0;
+    return (len);
+    }
+
+//#######################################################################
+static void DebugPrint (DEBUG_RECORD_T& rec, char* line)
+    {
+    int len;
+
+    switch ( rec.Kind )
+        {
+        case DKIND_ERROR:
+            len = snprintf (line, DEBUG_LINE_SIZE, "ERROR >> [%s] {%s} ", rec.Label, rec.Func);
+            break;
+        case DKIND_NAME:
+            len = snprintf (line, DEBUG_LINE_SIZE, "[%s-%d]{%s} ", rec.Label, rec.Index, DebugTextAt (rec, rec.Name));
+            break;
+        case DKIND_FLAG:
+            len = snprintf (line, DEBUG_LINE_SIZE, "[%s-%d]{%s} - %s - ", rec.Label, rec.Index, DebugTextAt (rec, rec.Name), DebugTextAt (rec, rec.Flag));
+            break;
+        default:
+            if ( rec.Index == DEBUG_NO_INDEX )
+                len = snprintf (line, DEBUG_LINE_SIZE, "[%s] ", rec.Label);
+            else
+                len = snprintf (line, DEBUG_LINE_SIZE, "[%s-%d] ", rec.Label, rec.Index);
+            break;
+        }
+    if ( len >= DEBUG_LINE_SIZE )
+        len = DEBUG_LINE_SIZE - 1;
+    DebugFormat (rec, &line[len], DEBUG_LINE_SIZE - len);
+    }
+
+//#######################################################################
+// Format and output everything in the ring.  Only one caller at a time
+// drains; a second caller returns immediately.
+//#######################################################################
+int DebugFlush ()
+    {
+    static char line[DEBUG_LINE_SIZE];
+    int         count = 0;
+
+    if ( debugFlushing.exchange (true) )
+        return (0);
+    for ( ;; )
+        {
+        DEBUG_RECORD_T& rec = debugRing[debugTail & (DEBUG_RING_DEPTH - 1)];
+        uint32_t        lap = debugTail & ~(DEBUG_RING_DEPTH - 1);
+
+        if ( rec.Seq.load (std::memory_order_acquire) != (lap + 1) )
+            break;
+        DebugPrint (rec, line);
+        rec.Seq.store (lap + DEBUG_RING_DEPTH, std::memory_order_release);     // slot free for producers
+        debugTail++;
+        Serial << line << endl;
+        count++;
+        }
+    debugPrinted += count;
+
+    uint32_t overflow = debugOverflow.load ();
+    uint32_t limited  = debugLimited.load ();
+    if ( (overflow + limited) != debugReported )
+        {
+        debugReported = overflow + limited;
+        Serial << "[DEBUG] dropped messages: " << overflow << " ring full  " << limited << " rate limited" << endl;
+        }
+    debugFlushing = false;
+    return (count);
+    }
+
+//#######################################################################
+static void DebugTask (void* arg)
+    {
+    for ( ;; )
+        {
+        DebugFlush ();
+        vTaskDelay (pdMS_TO_TICKS (DEBUG_TASK_PERIOD));
+        }
+    }
+
+//#######################################################################
+// Started automatically by the first message.  Runs at low priority
+// on core 0 so formatting and serial output stay off the loop core.
+//#######################################################################
+void DebugStartTask ()
+    {
+    if ( debugTaskStarted.exchange (true) )
+        return;
+    xTaskCreatePinnedToCore (DebugTask, "DebugOut", 4096, nullptr, tskIDLE_PRIORITY + 1, nullptr, 0);
+    }
+
+//#######################################################################
+// Allow count messages per call site in each period.  Zero count
+// removes the limit.
+//#######################################################################
+void DebugRateLimit (uint16_t count, uint16_t period_ms)
+    {
+    debugRateCount  = count;
+    debugRatePeriod = period_ms;
+    }
+
+//#######################################################################
+void DebugStats (DEBUG_STATS_T& stats)
+    {
+    stats.Recorded  = debugRecorded.load ();
+    stats.Printed   = debugPrinted.load ();
+    stats.Overflow  = debugOverflow.load ();
+    stats.Limited   = debugLimited.load ();
+    }
+#endif
+
+//#######################################################################
+const char* ErrorStringI2C (int err)
+    {
+    static const char* e1 = "data too long to fit in transmit buffer";
+    static const char* e2 = "Received NACK on transmit of address";
+    static const char* e3 = "received NACK on transmit of data";
+    static const char* e4 =  "other error";
+    static const char* e5 = "timeout";
 
     switch ( err )
         {
@@ -138,7 +494,11 @@ static const char* esp_rst_sdio         = "Reset over SDIO";
 static const char* esp_rst_not_known    = "Reset uknown reason";
 
 //#######################################################################
-void BootDebug ()
+// wait gives a serial monitor time to attach after power on.  A staged
+// start reports without it once the loop is already running.  Whatever
+// Breadcrumbs kept from the run before the reset follows the reason.
+//#######################################################################
+void BootDebug (bool wait)
     {
     const char* str;
 
@@ -150,7 +510,8 @@ void BootDebug ()
             break;
 
         case ESP_RST_POWERON:
-            delay (2000);
+            if ( wait )
+                delay (2000);
             str = esp_rst_poweron;
             break;
 
@@ -187,10 +548,11 @@ void BootDebug ()
             break;
 
         default:
-            printf ("%s $d\n", esp_rst_not_known, (uint32_t)reason);
+            printf ("%s %d\n", esp_rst_not_known, (int)reason);
             return;
         }
     printf ("\n\t\t********** %s **********\n\n", str);
+    Breadcrumbs.Report ();
     }
 
 //#######################################################################
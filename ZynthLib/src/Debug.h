@@ -7,21 +7,274 @@
 #pragma once
 #include <Arduino.h>
 #include <esp_debug_helpers.h>
+#include <atomic>
+#include <type_traits>
 
 #define DEBUG_SYNTH         1
+//#define DEBUG_DEFERRED    1           // define to record messages and format them later from a low priority task
 
 #define DEBUG_NO_INDEX      255
 
+//#######################################################################
+// Compile time message levels
+//  - Every module has a level.  Messages above it are discarded by the
+//    compiler together with their format strings and arguments.
+//  - Override any module from the build, e.g. -DDEBUG_LEVEL_ENV=1
+//  - The runtime level of a module can only be raised as far as the
+//    level compiled in.
+//#######################################################################
+#define DLEVEL_NONE         0
+#define DLEVEL_ERROR        1
+#define DLEVEL_INFO         2
+#define DLEVEL_DEBUG        3
+#define DLEVEL_TRACE        4           // per loop messages
+
+#ifdef DEBUG_SYNTH
+#define DLEVEL_DEFAULT      DLEVEL_TRACE
+#else
+#define DLEVEL_DEFAULT      DLEVEL_ERROR
+#endif
+
+#ifndef DEBUG_LEVEL_ENV
+#define DEBUG_LEVEL_ENV     DLEVEL_DEFAULT
+#endif
+#ifndef DEBUG_LEVEL_I2C
+#define DEBUG_LEVEL_I2C     DLEVEL_DEFAULT
+#endif
+#ifndef DEBUG_LEVEL_I2C_DA
+#define DEBUG_LEVEL_I2C_DA  DLEVEL_DEFAULT
+#endif
+#ifndef DEBUG_LEVEL_I2C_AD
+#define DEBUG_LEVEL_I2C_AD  DLEVEL_DEFAULT
+#endif
+#ifndef DEBUG_LEVEL_I2C_DIG
+#define DEBUG_LEVEL_I2C_DIG DLEVEL_DEFAULT
+#endif
+#ifndef DEBUG_LEVEL_I2C_MUX
+#define DEBUG_LEVEL_I2C_MUX DLEVEL_DEFAULT
+#endif
+
+enum class DMODULE : uint8_t
+    {
+    ENV = 0,            // envelope processing
+    I2C,                // I2C errors and validation
+    I2C_DA,             // D/A writes
+    I2C_AD,             // A/D register access
+    I2C_DIG,            // digital writes
+    I2C_MUX,            // bus mux selection
+    COUNT
+    };
+
+constexpr uint8_t DebugCompiledLevel (DMODULE module)
+    {
+    return (( module == DMODULE::ENV )     ? DEBUG_LEVEL_ENV     :
+            ( module == DMODULE::I2C )     ? DEBUG_LEVEL_I2C     :
+            ( module == DMODULE::I2C_DA )  ? DEBUG_LEVEL_I2C_DA  :
+            ( module == DMODULE::I2C_AD )  ? DEBUG_LEVEL_I2C_AD  :
+            ( module == DMODULE::I2C_DIG ) ? DEBUG_LEVEL_I2C_DIG :
+            ( module == DMODULE::I2C_MUX ) ? DEBUG_LEVEL_I2C_MUX : DLEVEL_NONE);
+    }
+
+constexpr bool DebugCompiled (DMODULE module, uint8_t level)
+    {
+    return (level <= DebugCompiledLevel (module));
+    }
+
+extern uint8_t DebugRuntimeLevel[(int)DMODULE::COUNT];
+
+inline bool DebugOn (DMODULE module, uint8_t level)
+    {
+    return (level <= DebugRuntimeLevel[(int)module]);
+    }
+
+void DebugSetLevel (DMODULE module, uint8_t level);
+
+// Output call is only compiled when the level is and only executed when the runtime level allows
+#ifndef DEBUG_DEFERRED
+#define DEBUG_OUT(module, level, call...)   { if constexpr ( DebugCompiled (DMODULE::module, level) ) { if ( DebugOn (DMODULE::module, level) ) { call; } } }
+#else
+// Deferred output also passes the rate limit kept for this call site
+#define DEBUG_OUT(module, level, call...)   { if constexpr ( DebugCompiled (DMODULE::module, level) ) { if ( DebugOn (DMODULE::module, level) ) { static DEBUG_SITE_T site_; if ( DebugAllow (site_) ) { call; } } } }
+#endif
+
 const String vFormat  (const char *const zcFormat, ...);
 const String vsFormat (const char *const zcFormat, va_list args);
 
+const char* ErrorStringI2C (int err);
+void        BootDebug      (bool wait = true);
+
+#ifndef DEBUG_DEFERRED
 void DebugMsg  (const char* label, uint8_t index, const char *const fmt, ...);
 void DebugMsgN (const char* label, uint8_t index, String name,  const char *const fmt, ...);
-void DebugMsgF (const char* label, uint8_t index, String name, char* flag, const char *const fmt, ...);
+void DebugMsgF (const char* label, uint8_t index, String name, const char* flag, const char *const fmt, ...);
 void ErrorMsg  (const char* label, const char* func, const char* const fmt, ...);
+#else
+//#######################################################################
+// Deferred debug output
+//  - The caller only copies the format pointer and the raw arguments
+//    into a lock-free ring.  A low priority task on the other core
+//    does the formatting and the serial output.
+//  - Each DEBUG_OUT call site is rate limited and every message lost
+//    to the rate limit or a full ring is counted.
+//#######################################################################
+#define DEBUG_RING_DEPTH    64          // records in the ring.  Must be a power of two
+#define DEBUG_MAX_ARGS      10          // arguments per message
+#define DEBUG_TEXT_SIZE     48          // bytes for copies of string arguments
+#define DEBUG_NO_TEXT       255
+#define DEBUG_RATE_COUNT    10          // default messages allowed per call site...
+#define DEBUG_RATE_PERIOD   100         // ...in this many mSec
+
+enum DEBUG_KIND_E : uint8_t
+    {
+    DKIND_MSG = 0,
+    DKIND_NAME,
+    DKIND_FLAG,
+    DKIND_ERROR
+    };
+
+enum DEBUG_ARG_E : uint8_t
+    {
+    DARG_INT = 0,
+    DARG_UINT,
+    DARG_DOUBLE,
+    DARG_STRING,
+    DARG_POINTER
+    };
+
+typedef union
+    {
+    int64_t     I;
+    uint64_t    U;
+    double      D;
+    uint8_t     T;                      // offset into Text
+    const void* P;
+    } DEBUG_ARG_T;
+
+typedef struct
+    {
+    std::atomic<uint32_t>   Seq;        // ring sequence for this slot
+    uint32_t                Time;       // micros () when recorded
+    const char*             Label;
+    const char*             Func;
+    const char*             Format;
+    uint8_t                 Kind;
+    uint8_t                 Index;
+    uint8_t                 Count;      // arguments used
+    uint8_t                 TextUsed;
+    uint8_t                 Name;       // offsets into Text
+    uint8_t                 Flag;
+    uint8_t                 Type[DEBUG_MAX_ARGS];
+    DEBUG_ARG_T             Arg[DEBUG_MAX_ARGS];
+    char                    Text[DEBUG_TEXT_SIZE];
+    } DEBUG_RECORD_T;
+
+typedef struct
+    {
+    uint32_t    Start;                  // mSec start of rate period
+    uint32_t    Count;                  // messages in this period
+    } DEBUG_SITE_T;
+
+typedef struct
+    {
+    uint32_t    Recorded;               // messages placed in the ring
+    uint32_t    Printed;                // messages formatted and output
+    uint32_t    Overflow;               // messages lost to a full ring
+    uint32_t    Limited;                // messages lost to call site rate limits
+    } DEBUG_STATS_T;
+
+bool            DebugAllow      (DEBUG_SITE_T& site);
+DEBUG_RECORD_T* DebugReserve    (uint32_t& pos);
+void            DebugCommit     (DEBUG_RECORD_T* rec, uint32_t pos);
+uint8_t         DebugText       (DEBUG_RECORD_T& rec, const char* str);
+int             DebugFlush      (void);
+void            DebugStartTask  (void);
+void            DebugRateLimit  (uint16_t count, uint16_t period_ms);
+void            DebugStats      (DEBUG_STATS_T& stats);
+
+//#######################################################################
+template <typename T> inline void DebugPackArg (DEBUG_RECORD_T& rec, const T& val)
+    {
+    typedef typename std::decay<T>::type D;
+    DEBUG_ARG_T& arg  = rec.Arg[rec.Count];
+    uint8_t&     type = rec.Type[rec.Count++];
+
+    if constexpr ( std::is_floating_point<D>::value )
+        {
+        arg.D = val;
+        type  = DARG_DOUBLE;
+        }
+    else if constexpr ( std::is_enum<D>::value || std::is_same<D, bool>::value )
+        {
+        arg.I = (int64_t)val;
+        type  = DARG_INT;
+        }
+    else if constexpr ( std::is_integral<D>::value )
+        {
+        if ( std::is_signed<D>::value )
+            {
+            arg.I = val;
+            type  = DARG_INT;
+            }
+        else
+            {
+            arg.U = val;
+            type  = DARG_UINT;
+            }
+        }
+    else if constexpr ( std::is_same<D, String>::value )
+        {
+        arg.T = DebugText (rec, val.c_str ());
+        type  = DARG_STRING;
+        }
+    else if constexpr ( std::is_convertible<D, const char*>::value )
+        {
+        arg.T = DebugText (rec, val);
+        type  = DARG_STRING;
+        }
+    else
+        {
+        static_assert (std::is_pointer<D>::value, "Unsupported debug message argument type");
+        arg.P = (const void*)val;
+        type  = DARG_POINTER;
+        }
+    }
+
+//#######################################################################
+template <typename... A> inline void DebugRecord (uint8_t kind, const char* label, uint8_t index, const char* func,
+                                                  const char* name, const char* flag, const char* const fmt, const A&... args)
+    {
+    static_assert (sizeof... (A) <= DEBUG_MAX_ARGS, "Too many debug message arguments");
+    uint32_t        pos;
+    DEBUG_RECORD_T* rec = DebugReserve (pos);
+
+    if ( rec == nullptr )
+        return;
+    rec->Kind     = kind;
+    rec->Label    = label;
+    rec->Index    = index;
+    rec->Func     = func;
+    rec->Format   = fmt;
+    rec->Count    = 0;
+    rec->TextUsed = 0;
+    rec->Name     = ( name ) ? DebugText (*rec, name) : DEBUG_NO_TEXT;
+    rec->Flag     = ( flag ) ? DebugText (*rec, flag) : DEBUG_NO_TEXT;
+    (DebugPackArg (*rec, args), ...);
+    DebugCommit (rec, pos);
+    }
+
+//#######################################################################
+template <typename... A> inline void DebugMsg (const char* label, uint8_t index, const char *const fmt, const A&... args)
+    { DebugRecord (DKIND_MSG, label, index, nullptr, nullptr, nullptr, fmt, args...); }
+
+template <typename... A> inline void DebugMsgN (const char* label, uint8_t index, const String& name, const char *const fmt, const A&... args)
+    { DebugRecord (DKIND_NAME, label, index, nullptr, name.c_str (), nullptr, fmt, args...); }
+
+template <typename... A> inline void DebugMsgF (const char* label, uint8_t index, const String& name, const char* flag, const char *const fmt, const A&... args)
+    { DebugRecord (DKIND_FLAG, label, index, nullptr, name.c_str (), flag, fmt, args...); }
 
-char* ErrorStringI2C (int err);
-void  BootDebug      (void);
+template <typename... A> inline void ErrorMsg (const char* label, const char* func, const char* const fmt, const A&... args)
+    { DebugRecord (DKIND_ERROR, label, DEBUG_NO_INDEX, func, nullptr, nullptr, fmt, args...); }
+#endif
 
 #define PAUSE   {printf("--- %s:%d\n",__FILE_NAME__,__LINE__);while(!Serial.available ()) continue;char s=Serial.read();}
 #define DbgD(d) {printf("==> %s:%d %s = %d\n",__FILE_NAME__,__LINE__, #d, d);}
@@ -6,12 +6,22 @@
 //#######################################################################
 //host libraries
 #include <Arduino.h>
+#ifdef ESP_PLATFORM
+#include <Preferences.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 //ZynthLib
 #include <ZynthTime.h>
 #include <Debug.h>
 #include <I2Cdevices.h>
 #include <SoftLFO.h>
+#include <Trace.h>
+#include <Crumbs.h>
 
 //local includes
 #include "Envelope.h"
@@ -19,36 +29,38 @@
 using namespace std;
 
 
-#ifdef DEBUG_SYNTH
 static const char* Label = "ENV";
-#define DBG(args...)  {if (debugENV){DebugMsgF(Label,_Index,_Name,stateLabel[(int)_State],args); } }
-#else
-#define DBG(args...)
-#endif
+static const char* LabelError = "ENV";
+#define ERROR(args...) DEBUG_OUT (ENV, DLEVEL_ERROR, ErrorMsg (LabelError, __FUNCTION__, args))
+#define DBG(args...)  DEBUG_OUT (ENV, DLEVEL_DEBUG, DebugMsgF (Label, _Index, _Name, stateLabel[(int)_State], args))
+#define DBGT(args...) DEBUG_OUT (ENV, DLEVEL_TRACE, DebugMsgF (Label, _Index, _Name, stateLabel[(int)_State], args))
 
-static char* stateLabel[] = { "IDLE", "START", "ATTACK", "DECAY", "SUSTAIN", "RELEASE" };
+static const char* stateLabel[] = { "IDLE", "START", "ATTACK", "DECAY", "SUSTAIN", "RELEASE" };
 #define TIME_THRESHOLD  0.0
-static bool debugENV = false;
 
 //#######################################################################
 // Envelope creation class
 //#######################################################################
 ENV_GENERATOR_C::ENV_GENERATOR_C ()
     {
+    _pPending     = nullptr;
+    _PendingSize  = 0;
+    _PendingReady = false;
     }
 
 //#######################################################################
-// call to enable debug dumps if DEBUG_SYNTH was on at compile time
+// call to enable debug dumps up to the level compiled in
 //#######################################################################
 void ENV_GENERATOR_C::Debug (bool state)
     {
-    debugENV = state;
+    DebugSetLevel (DMODULE::ENV, ( state ) ? DLEVEL_TRACE : DLEVEL_ERROR);
     }
 
 //#######################################################################
 ENVELOPE_C* ENV_GENERATOR_C::NewADSR (uint8_t index, String name, uint16_t device, uint16_t device_range, uint8_t& usecount)
     {
     ENVELOPE_C adsl (index, name, device, device_range, usecount);
+    adsl.SetSlot (_Envelopes.size ());
     _Envelopes.push_back (adsl);
     return (&(_Envelopes.back ()));
     }
@@ -56,6 +68,14 @@ ENVELOPE_C* ENV_GENERATOR_C::NewADSR (uint8_t index, String name, uint16_t devic
 //#######################################################################
 void ENV_GENERATOR_C::Loop ()
     {
+    TRACE_SCOPE (ENV_LOOP, 0);
+    uint32_t zt     = micros ();
+    int      active = 0;
+
+    REC_POINT_F (ENV_LOOP, 0, 0, ZyTime.DeltaTimeMS ());
+
+    if ( _PendingReady )
+        ApplyPending ();
     SoftLFO.Loop ();                // execute software LFO
 
     for ( deque<ENVELOPE_C>::iterator it = _Envelopes.begin();  it != _Envelopes.end();  ++it )
@@ -64,9 +84,197 @@ void ENV_GENERATOR_C::Loop ()
             {
             it->Process (ZyTime.DeltaTimeMS ());
             it->Update ();
+            active++;
             }
         }
+    TRACE_COUNTER (ENV_ACTIVE, active);
+    Breadcrumbs.Active (active);
+    ZyTime.PhaseEnd (ZPHASE::ENVELOPE, zt);
+
+    zt = micros ();
     I2cDevices.Update ();           // process all changes on I2C devices
+    ZyTime.PhaseEnd (ZPHASE::I2C_FLUSH, zt);
+    }
+
+//#######################################################################
+size_t ENV_GENERATOR_C::PresetSize ()
+    {
+    return (sizeof (ENV_PRESET_HEADER_T) + (_Envelopes.size () * sizeof (ENV_PARAMS_T)));
+    }
+
+//#######################################################################
+// Builds the preset image of every envelope and the software LFO.
+// Returns the bytes used or 0 when the buffer is too small.
+//#######################################################################
+size_t ENV_GENERATOR_C::Snapshot (uint8_t* pbuf, size_t size)
+    {
+    size_t needed = PresetSize ();
+
+    if ( size < needed )
+        return (0);
+
+    ENV_PRESET_HEADER_T* phdr    = (ENV_PRESET_HEADER_T*)pbuf;
+    ENV_PARAMS_T*        pparams = (ENV_PARAMS_T*)(pbuf + sizeof (ENV_PRESET_HEADER_T));
+
+    memset (phdr, 0, sizeof (ENV_PRESET_HEADER_T));
+    phdr->Magic     = ENV_PRESET_MAGIC;
+    phdr->Version   = ENV_PRESET_VERSION;
+    phdr->Count     = _Envelopes.size ();
+    phdr->ParamSize = sizeof (ENV_PARAMS_T);
+    phdr->LfoCoarse = SoftLFO.GetFreqCoarse ();
+    phdr->LfoFine   = SoftLFO.GetFreqFine ();
+    phdr->LfoMidi   = SoftLFO.GetMidi ();
+    for ( deque<ENVELOPE_C>::iterator it = _Envelopes.begin();  it != _Envelopes.end();  ++it, ++pparams )
+        it->GetParams (*pparams);
+    return (needed);
+    }
+
+//#######################################################################
+// Checks the image and copies it in whole for the start of the next
+// Loop (), so a patch change lands in a single tick and never half way
+// through one.  Call from the task that runs Loop ().
+//#######################################################################
+bool ENV_GENERATOR_C::Recall (const uint8_t* pbuf, size_t size)
+    {
+    const ENV_PRESET_HEADER_T* phdr = (const ENV_PRESET_HEADER_T*)pbuf;
+
+    if ( size < sizeof (ENV_PRESET_HEADER_T) || phdr->Magic != ENV_PRESET_MAGIC )
+        {
+        ERROR ("Not a preset");
+        return (false);
+        }
+    if ( phdr->Version != ENV_PRESET_VERSION || phdr->ParamSize != sizeof (ENV_PARAMS_T) )
+        {
+        ERROR ("Preset version %d not supported", phdr->Version);
+        return (false);
+        }
+    if ( phdr->Count != _Envelopes.size () || size < PresetSize () )
+        {
+        ERROR ("Preset has %d envelopes, expected %d", phdr->Count, _Envelopes.size ());
+        return (false);
+        }
+
+    if ( _PendingSize < PresetSize () )
+        {
+        delete[] _pPending;
+        _PendingSize = PresetSize ();
+        _pPending    = new uint8_t[_PendingSize];
+        }
+    memcpy (_pPending, pbuf, PresetSize ());
+    _PendingReady = true;
+    EventRecorder.RecordBlob (REC_ID::PRESET, 0, _pPending, PresetSize ());
+    return (true);
+    }
+
+//#######################################################################
+// Runs ahead of the envelopes so they all see the new settings at once.
+// Changed outputs go out with this tick's I2C update.
+//#######################################################################
+void ENV_GENERATOR_C::ApplyPending ()
+    {
+    const ENV_PRESET_HEADER_T* phdr    = (const ENV_PRESET_HEADER_T*)_pPending;
+    const ENV_PARAMS_T*        pparams = (const ENV_PARAMS_T*)(_pPending + sizeof (ENV_PRESET_HEADER_T));
+
+    SoftLFO.Restore (phdr->LfoCoarse, phdr->LfoFine, phdr->LfoMidi);
+    for ( deque<ENVELOPE_C>::iterator it = _Envelopes.begin();  it != _Envelopes.end();  ++it, ++pparams )
+        {
+        it->SetParams (*pparams);
+        it->Update ();
+        }
+    _PendingReady = false;
+    }
+
+//#######################################################################
+// Stored in NVS flash on the ESP32 and in a memory mapped file on a
+// host build.
+//#######################################################################
+bool ENV_GENERATOR_C::SavePreset (int slot)
+    {
+    size_t size = PresetSize ();
+    bool   ok;
+
+    if ( slot < 0 || slot >= ENV_PRESET_SLOTS )
+        return (false);
+#ifdef ESP_PLATFORM
+    Preferences prefs;
+    char        key[8];
+    uint8_t*    pbuf = new uint8_t[size];
+
+    snprintf (key, sizeof (key), "p%d", slot);
+    ok = prefs.begin (ENV_PRESET_NAMESPACE, false);
+    if ( ok )
+        {
+        Snapshot (pbuf, size);
+        ok = ( prefs.putBytes (key, pbuf, size) == size );
+        prefs.end ();
+        }
+    delete[] pbuf;
+#else
+    char name[32];
+
+    snprintf (name, sizeof (name), ENV_PRESET_NAMESPACE "%d.bin", slot);
+    int fd = open (name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if ( fd < 0 )
+        return (false);
+    ok = ( ftruncate (fd, size) == 0 );
+    if ( ok )
+        {
+        void* pmap = mmap (nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ok = ( pmap != MAP_FAILED );
+        if ( ok )
+            {
+            Snapshot ((uint8_t*)pmap, size);
+            munmap (pmap, size);
+            }
+        }
+    close (fd);
+#endif
+    if ( !ok )
+        ERROR ("Preset %d store failed", slot);
+    return (ok);
+    }
+
+//#######################################################################
+bool ENV_GENERATOR_C::LoadPreset (int slot)
+    {
+    bool ok = false;
+
+    if ( slot < 0 || slot >= ENV_PRESET_SLOTS )
+        return (false);
+#ifdef ESP_PLATFORM
+    Preferences prefs;
+    char        key[8];
+    size_t      size = PresetSize ();
+    uint8_t*    pbuf = new uint8_t[size];
+
+    snprintf (key, sizeof (key), "p%d", slot);
+    if ( prefs.begin (ENV_PRESET_NAMESPACE, true) )
+        {
+        if ( prefs.getBytes (key, pbuf, size) == size )
+            ok = Recall (pbuf, size);
+        prefs.end ();
+        }
+    delete[] pbuf;
+#else
+    char        name[32];
+    struct stat st;
+
+    snprintf (name, sizeof (name), ENV_PRESET_NAMESPACE "%d.bin", slot);
+    int fd = open (name, O_RDONLY);
+    if ( fd < 0 )
+        return (false);
+    if ( fstat (fd, &st) == 0 && st.st_size > 0 )
+        {
+        void* pmap = mmap (nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if ( pmap != MAP_FAILED )
+            {
+            ok = Recall ((const uint8_t*)pmap, st.st_size);
+            munmap (pmap, st.st_size);
+            }
+        }
+    close (fd);
+#endif
+    return (ok);
     }
 
 //#######################################################################
@@ -76,6 +284,7 @@ ENVELOPE_C::ENVELOPE_C (uint8_t index, String name, uint16_t device, uint16_t de
     _Name         = name;
     _DevicePortIO = device;
     _Index        = index + 1;
+    _Slot         = 0;
     _Muted        = false;
     _DualUse      = false;
     _Current      = 0;
@@ -87,6 +296,7 @@ ENVELOPE_C::ENVELOPE_C (uint8_t index, String name, uint16_t device, uint16_t de
     _ReleaseTime  = 0;
     _Active       = 0;
     _UseSoftLFO   = false;
+    _ScaleLFO     = 0.2;
     _DamperMode   = DAMPER::OFF;
     _Expression   = 1.0;
     _DeviceRange  = device_range;
@@ -111,6 +321,7 @@ void ENVELOPE_C::Clear ()
 //#######################################################################
 void ENVELOPE_C::Mute (bool state)
     {
+    REC_POINT (MUTE, _Slot, state, 0);
     _Muted = state;
     DBG ("Mute set to %d", state);
     Clear ();
@@ -120,6 +331,7 @@ void ENVELOPE_C::Mute (bool state)
 //#######################################################################
 void ENVELOPE_C::SetTime (ESTATE state, float time)
     {
+    REC_POINT_F (SET_TIME, _Slot, (uint16_t)state, time);
     switch (state )
         {
         case ESTATE::ATTACK:
@@ -131,6 +343,8 @@ void ENVELOPE_C::SetTime (ESTATE state, float time)
         case ESTATE::RELEASE:
             _ReleaseTime = time;
             break;
+        default:
+            break;
         }
     DBG ("%s - Time setting > %f mSec", stateLabel[(int)state], time );
     }
@@ -151,6 +365,8 @@ float ENVELOPE_C::GetTime (ESTATE state)
         case ESTATE::RELEASE:
             val = _ReleaseTime;
             break;
+        default:
+            break;
         }
     return (val);
     }
@@ -160,6 +376,7 @@ void ENVELOPE_C::SetLevel (ESTATE state, float percent)
     {
     String str;
 
+    REC_POINT_F (SET_LEVEL, _Slot, (uint16_t)state, percent);
     switch ( state )
         {
         case ESTATE::START:
@@ -188,6 +405,7 @@ void ENVELOPE_C::SetLevel (ESTATE state, float percent)
             _SetSustain = percent;
             break;
         case ESTATE::RELEASE:
+        default:
             break;
         }
     DBG ("Setting %s > %f", str.c_str (), percent );
@@ -213,6 +431,7 @@ float ENVELOPE_C::GetLevel (ESTATE state)
             val = _SetSustain;
             break;
         case ESTATE::RELEASE:
+        default:
             break;
         }
     return (val);
@@ -221,6 +440,7 @@ float ENVELOPE_C::GetLevel (ESTATE state)
 //#######################################################################
 void ENVELOPE_C::SetDualUse (bool sel)
     {
+    REC_POINT (DUAL_USE, _Slot, sel, 0);
     _DualUse = sel;
 
     if ( sel )
@@ -241,14 +461,62 @@ void ENVELOPE_C::SetDualUse (bool sel)
 //#######################################################################
 void ENVELOPE_C::SetModulationLevel (float lvl)
     {
+    REC_POINT_F (MOD_LEVEL, _Slot, 0, lvl);
     _Current = _Bottom + (_LevelDelta * lvl);
     _Updated = true;
     Update ();
     }
 
+//#######################################################################
+void ENVELOPE_C::GetParams (ENV_PARAMS_T& params)
+    {
+    params.Top         = _Top;
+    params.Bottom      = _Bottom;
+    params.Sustain     = _SetSustain;
+    params.AttackTime  = _AttackTime;
+    params.DecayTime   = _DecayTime;
+    params.ReleaseTime = _ReleaseTime;
+    params.Expression  = _Expression;
+    params.ScaleLFO    = _ScaleLFO;
+    params.DamperMode  = (uint8_t)_DamperMode;
+    params.UseSoftLFO  = _UseSoftLFO;
+    params.DualUse     = _DualUse;
+    params.Spare       = 0;
+    }
+
+//#######################################################################
+// Preset recall.  No debug output and no write, the generator updates
+// every envelope together once all are set.  A running envelope keeps
+// its current stage and picks up the new times at the next one.
+//#######################################################################
+void ENVELOPE_C::SetParams (const ENV_PARAMS_T& params)
+    {
+    _Top         = params.Top;
+    _Bottom      = params.Bottom;
+    _SetSustain  = params.Sustain;
+    _AttackTime  = params.AttackTime;
+    _DecayTime   = params.DecayTime;
+    _ReleaseTime = params.ReleaseTime;
+    _Expression  = params.Expression;
+    _ScaleLFO    = params.ScaleLFO;
+    _DamperMode  = (DAMPER)params.DamperMode;
+    _UseSoftLFO  = params.UseSoftLFO;
+    if ( params.DualUse )
+        {
+        _LevelDelta = _Top - _Bottom;
+        if ( _State == ESTATE::IDLE )
+            _Current = _Bottom;
+        }
+    else if ( _DualUse )
+        _Current = 0.0;                 // leaving dual use drops the held level as SetDualUse does
+    _DualUse     = params.DualUse;
+    _Updated = true;
+    }
+
 //#######################################################################
 void ENVELOPE_C::SetSoftLFO (bool sel)
     {
+    REC_POINT (SOFT_LFO, _Slot, sel, 0);
     _UseSoftLFO = sel;
     DBG ("Toggle %s > %s", _Name, (( sel ) ? "ON" : "Off") );
     }
@@ -257,6 +525,7 @@ void ENVELOPE_C::SetSoftLFO (bool sel)
 //#######################################################################
 void ENVELOPE_C::Start ()
     {
+    REC_POINT (START, _Slot, 0, 0);
     if ( _Active || (_Top == 0.0 || _Muted ) )
         return;
     _Active = true;
@@ -268,6 +537,7 @@ void ENVELOPE_C::Start ()
 //#######################################################################
 void ENVELOPE_C::End ()
     {
+    REC_POINT (END, _Slot, 0, 0);
     if ( !_Active )
         return;
     _TriggerEnd = true;
@@ -277,6 +547,7 @@ void ENVELOPE_C::End ()
 //#######################################################################
 void ENVELOPE_C::SetOverride (uint16_t data)
     {
+    REC_POINT (OVERRIDE, _Slot, 0, (int32_t)data);
     I2cDevices.D2Analog (_DevicePortIO, data);
     }
 
@@ -297,7 +568,7 @@ void ENVELOPE_C::Update ()
                 output = 0.0;
             }
         int16_t z = (int16_t)(_DeviceRange * output * _Expression);    //Calculate final D to A with output level and expression level
-        DBG ("Updating port %d with %d", _DevicePortIO, z)
+        DBGT ("Updating port %d with %d", _DevicePortIO, z)
         I2cDevices.D2Analog (_DevicePortIO, z);;
         _Updated = false;
         }
@@ -307,6 +578,8 @@ void ENVELOPE_C::Update ()
 //#######################################################################
 void ENVELOPE_C::Process (float deltaTime)
     {
+    TRACE_SCOPE (ENV_PROCESS, _Index);
+
     if ( _UseSoftLFO )
         _Updated = true;
 
@@ -353,7 +626,7 @@ void ENVELOPE_C::Process (float deltaTime)
                 {
                 _Current  = _Bottom + ((_Timer / _TargetTime) * _Delta);
                 _Updated = true;
-                DBG ("Timer > %f mSec at level %f", _Timer, _Current);
+                DBGT ("Timer > %f mSec at level %f", _Timer, _Current);
                 return;
                 }
             _Current     = _Top;
@@ -385,7 +658,7 @@ void ENVELOPE_C::Process (float deltaTime)
                 {
                 _Current = _Sustain + ((_Timer / _DecayTime) * _Delta);
                 _Updated = true;
-                DBG ("Timer > %f mSec at level %f", _Timer, _Current);
+                DBGT ("Timer > %f mSec at level %f", _Timer, _Current);
                 return;
                 }
             _Current = _Sustain;
@@ -422,7 +695,7 @@ void ENVELOPE_C::Process (float deltaTime)
                 {
                 _Current = _Bottom + ((_Timer / _ReleaseTime) * _Delta);
                 _Updated = true;
-                DBG ("Timer > %f mSec at level %f", _Timer, _Current);
+                DBGT ("Timer > %f mSec at level %f", _Timer, _Current);
 
                 // Process string damper
                 bool damper = false;
@@ -445,6 +718,8 @@ void ENVELOPE_C::Process (float deltaTime)
             Clear ();          // We got to here so this envelope process in finished.
             return;
             }
+        default:
+            break;
         }
     //***************************************
     //  This should never happen
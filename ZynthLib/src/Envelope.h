@@ -6,6 +6,7 @@
 //#######################################################################
 #pragma once
 #include <deque>
+#include "Recorder.h"
 
 //###########################################
 // Envelope selection bytes
@@ -47,6 +48,46 @@ enum class DAMPER : byte
 //###########################################
 #define FromUnityDA(vf) (vf * )
 
+//###########################################
+// Envelope settings kept in a preset
+//###########################################
+typedef struct
+    {
+    float       Top;
+    float       Bottom;
+    float       Sustain;
+    float       AttackTime;
+    float       DecayTime;
+    float       ReleaseTime;
+    float       Expression;
+    float       ScaleLFO;
+    uint8_t     DamperMode;
+    uint8_t     UseSoftLFO;
+    uint8_t     DualUse;
+    uint8_t     Spare;
+    } ENV_PARAMS_T;
+
+//###########################################
+// Preset image is this header followed by
+// one ENV_PARAMS_T per envelope in creation
+// order.
+//###########################################
+#define ENV_PRESET_MAGIC        0x5A45
+#define ENV_PRESET_VERSION      1
+#define ENV_PRESET_SLOTS        16
+#define ENV_PRESET_NAMESPACE    "zenv"  // NVS namespace, or file name prefix on a host build
+
+typedef struct
+    {
+    uint16_t    Magic;
+    uint16_t    Version;
+    uint16_t    Count;          // envelopes that follow
+    uint16_t    ParamSize;      // sizeof (ENV_PARAMS_T) it was written with
+    int16_t     LfoCoarse;
+    int16_t     LfoFine;
+    uint8_t     LfoMidi;
+    uint8_t     Spare[3];
+    } ENV_PRESET_HEADER_T;
 
 
 //#######################################################################
@@ -93,6 +134,7 @@ private:
     // Fixed parameters at initialization
     String      _Name;
     byte        _Index;
+    uint8_t     _Slot;          // creation order, names the envelope in an event log
     uint16_t    _DevicePortIO;
     float       _DeviceRange;
 
@@ -112,12 +154,18 @@ public:
     void        SetSoftLFO          (bool sel);
     void        SetDualUse          (bool sel);
     void        SetModulationLevel  (float lvl);
+    void        GetParams           (ENV_PARAMS_T& params);
+    void        SetParams           (const ENV_PARAMS_T& params);
 
     uint16_t    GetPortIO           ()                  { return (_DevicePortIO); }  // Return D/A channel number
-    void        SetDamperMode       (DAMPER mode)       { _DamperMode = mode; }
-    void        Start               (bool modstate)     { _UseSoftLFO = modstate; _ScaleLFO = 0.2; Start (); }
-    void        Expression          (float level)       { _Expression = level; }
-    void        Damper              (bool state)        { _Damper = state; }
+    uint16_t    GetRange            ()                  { return (_DeviceRange); }
+    uint8_t     GetIndex            ()                  { return (_Index - 1); }
+    uint8_t*    UseCount            ()                  { return (&_UseCount); }
+    void        SetSlot             (uint8_t slot)      { _Slot = slot; }
+    void        SetDamperMode       (DAMPER mode)       { REC_POINT (DAMPER_MODE, _Slot, (uint16_t)mode, 0); _DamperMode = mode; }
+    void        Start               (bool modstate)     { REC_POINT (START_MOD, _Slot, modstate, 0); _UseSoftLFO = modstate; _ScaleLFO = 0.2; Start (); }
+    void        Expression          (float level)       { REC_POINT_F (EXPRESSION, _Slot, 0, level); _Expression = level; }
+    void        Damper              (bool state)        { REC_POINT (DAMPER, _Slot, state, 0); _Damper = state; }
 
     int IsActive (void)
         { return (_Active); }
@@ -128,12 +176,28 @@ class ENV_GENERATOR_C
     {
 private:
     std::deque<ENVELOPE_C>  _Envelopes;
+    uint8_t*                _pPending;      // preset waiting for the next Loop
+    size_t                  _PendingSize;
+    volatile bool           _PendingReady;
+
+    void        ApplyPending    (void);
 
 public:
                 ENV_GENERATOR_C (void);
     ENVELOPE_C* NewADSR         (uint8_t index, String name, uint16_t device, uint16_t device_range, uint8_t& usecount);
     void        Debug           (bool state);
     void        Loop            (void);
+    size_t      PresetSize      (void);
+    size_t      Snapshot        (uint8_t* pbuf, size_t size);
+    bool        Recall          (const uint8_t* pbuf, size_t size);
+    bool        SavePreset      (int slot);
+    bool        LoadPreset      (int slot);
+
+    int Count (void)
+        { return (_Envelopes.size ()); }
+
+    ENVELOPE_C* Get (int slot)
+        { return (( slot >= 0 && slot < (int)_Envelopes.size () ) ? &_Envelopes[slot] : nullptr); }
     };
 
 //#######################################################################
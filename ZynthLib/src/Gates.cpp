@@ -0,0 +1,300 @@
+//#######################################################################
+// Module:     Gates.cpp
+// Descrption: Timed gate and trigger edges for the digital outputs
+// Creator:    markeby
+// Date:       10/19/2026
+//#######################################################################
+//host libraries
+#include <Arduino.h>
+
+//ZynthLib
+#include "Gates.h"
+#include "I2Cdevices.h"
+#include "Debug.h"
+
+static const char* LabelError = "GATE";
+#define ERROR(args...)    DEBUG_OUT (I2C_DIG, DLEVEL_ERROR, ErrorMsg (LabelError, __FUNCTION__, args))
+
+// signed distance so the ordering survives micros () rolling over
+#define GATE_BEFORE(a, b)   ((int32_t)((a) - (b)) < 0)
+
+//#######################################################################
+//#######################################################################
+    GATE_ENGINE_C::GATE_ENGINE_C ()
+    {
+    _Count = 0;
+    _Spin  = portMUX_INITIALIZER_UNLOCKED;
+    _Task  = nullptr;
+    _Timer = nullptr;
+    memset (&_Stats, 0, sizeof (_Stats));
+    }
+
+//#######################################################################
+// Call after I2cDevices.Begin ().  Without the timer edges wait for
+// Loop () and the next Update ().
+//#######################################################################
+bool GATE_ENGINE_C::Begin (bool timer)
+    {
+    esp_timer_create_args_t args = {};
+
+    if ( !timer || _Task != nullptr )
+        return (true);
+    args.callback        = TimerFire;
+    args.arg             = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name            = "gates";
+    if ( esp_timer_create (&args, &_Timer) != ESP_OK )
+        {
+        ERROR ("Unable to create gate timer");
+        _Timer = nullptr;
+        return (false);
+        }
+    if ( xTaskCreate (GateTask, "Gates", GATE_TASK_STACK, this, GATE_TASK_PRIORITY, &_Task) != pdPASS )
+        {
+        ERROR ("Unable to start gate task");
+        _Task = nullptr;
+        return (false);
+        }
+    return (true);
+    }
+
+//#######################################################################
+// Caller holds the spin lock.  Edges due at the same time keep the
+// order they were scheduled in.  Returns the queue position or -1.
+//#######################################################################
+int GATE_ENGINE_C::Insert (short device, bool state, uint32_t at)
+    {
+    if ( _Count >= GATE_QUEUE_DEPTH )
+        {
+        _Stats.Dropped++;
+        return (-1);
+        }
+
+    int z = _Count++;
+    while ( z > 0 && GATE_BEFORE (at, _Queue[z - 1].Time) )
+        {
+        _Queue[z] = _Queue[z - 1];
+        z--;
+        }
+    _Queue[z].Time   = at;
+    _Queue[z].Device = device;
+    _Queue[z].State  = state;
+    _Stats.Scheduled++;
+    return (z);
+    }
+
+//#######################################################################
+// Caller holds the spin lock.  Drops the edges for an output that are
+// due at or after the given time.
+//#######################################################################
+void GATE_ENGINE_C::Remove (short device, uint32_t from)
+    {
+    int n = 0;
+
+    for ( int z = 0;  z < _Count;  z++ )
+        {
+        if ( _Queue[z].Device != device || GATE_BEFORE (_Queue[z].Time, from) )
+            _Queue[n++] = _Queue[z];
+        }
+    _Count = n;
+    }
+
+//#######################################################################
+bool GATE_ENGINE_C::Schedule (short device, bool state, uint32_t at)
+    {
+    if ( device < 0 || device >= I2cDevices.GetDeviceCount () || !I2cDevices.IsDigitalOut (device) )
+        return (false);
+
+    portENTER_CRITICAL (&_Spin);
+    int pos = Insert (device, state, at);
+    portEXIT_CRITICAL (&_Spin);
+
+    if ( pos == 0 && _Task != nullptr )                 // new earliest edge so the timer has to move
+        xTaskNotifyGive (_Task);
+    return (pos >= 0);
+    }
+
+//#######################################################################
+// Rise after the delay and fall width uSec later.  A retrigger while
+// the output is still high drops the pending fall, stretching the pulse
+// to end width after the new rise.
+//#######################################################################
+bool GATE_ENGINE_C::Pulse (short device, uint32_t width, uint32_t delay)
+    {
+    uint32_t at  = micros () + delay;
+    int      pos = -1;
+
+    if ( device < 0 || device >= I2cDevices.GetDeviceCount () || !I2cDevices.IsDigitalOut (device) )
+        return (false);
+
+    portENTER_CRITICAL (&_Spin);
+    Remove (device, at);
+    if ( _Count + 2 <= GATE_QUEUE_DEPTH )
+        {
+        pos = Insert (device, true, at);
+        Insert (device, false, at + width);
+        }
+    else
+        _Stats.Dropped += 2;
+    portEXIT_CRITICAL (&_Spin);
+
+    if ( pos == 0 && _Task != nullptr )
+        xTaskNotifyGive (_Task);
+    return (pos >= 0);
+    }
+
+//#######################################################################
+// Forget every pending edge for an output.  Its current state is left
+// as it is.
+//#######################################################################
+void GATE_ENGINE_C::Cancel (short device)
+    {
+    portENTER_CRITICAL (&_Spin);
+    Remove (device, ( _Count ) ? _Queue[0].Time : 0);      // from the earliest edge on
+    portEXIT_CRITICAL (&_Spin);
+    }
+
+//#######################################################################
+// Drop every pending edge.  For a board map swap, where the device
+// numbers they were queued for no longer mean the same outputs.
+//#######################################################################
+void GATE_ENGINE_C::CancelAll ()
+    {
+    portENTER_CRITICAL (&_Spin);
+    _Count = 0;
+    portEXIT_CRITICAL (&_Spin);
+    }
+
+//#######################################################################
+// Pull every edge due within the merge window into the transmit images
+// so they share one write per board.  A second edge for the same output
+// waits for the next pass so a late rise and fall never cancel out.
+// Returns the number of edges applied.
+//#######################################################################
+int GATE_ENGINE_C::Apply (uint32_t now)
+    {
+    GATE_EVENT_T due[GATE_QUEUE_DEPTH];
+    int          count = 0;
+
+    portENTER_CRITICAL (&_Spin);
+    while ( count < _Count && !GATE_BEFORE (now + GATE_MERGE_WINDOW, _Queue[count].Time) )
+        {
+        bool again = false;
+
+        for ( int z = 0;  z < count;  z++ )
+            {
+            if ( due[z].Device == _Queue[count].Device )
+                again = true;
+            }
+        if ( again )
+            break;
+        due[count] = _Queue[count];
+        count++;
+        }
+    if ( count > 0 )
+        {
+        memmove (_Queue, _Queue + count, (_Count - count) * sizeof (GATE_EVENT_T));
+        _Count -= count;
+        }
+    portEXIT_CRITICAL (&_Spin);
+
+    for ( int z = 0;  z < count;  z++ )
+        {
+        int32_t late = now - due[z].Time;
+
+        I2cDevices.DigitalOut (due[z].Device, due[z].State);
+        if ( late > 0 && (uint32_t)late > _Stats.MaxLate )
+            _Stats.MaxLate = late;
+        }
+    _Stats.Applied += count;
+    if ( count > 1 )
+        _Stats.Merged += count - 1;
+    return (count);
+    }
+
+//#######################################################################
+// Only the gate task sets the timer so there is never a race over
+// which edge it is waiting for.
+//#######################################################################
+void GATE_ENGINE_C::Arm ()
+    {
+    uint32_t next;
+
+    portENTER_CRITICAL (&_Spin);
+    int count = _Count;
+    next = ( count ) ? _Queue[0].Time : 0;
+    portEXIT_CRITICAL (&_Spin);
+
+    esp_timer_stop (_Timer);                            // harmless when it is not running
+    if ( count == 0 )
+        return;
+
+    int32_t wait = next - micros ();
+    if ( wait <= GATE_MERGE_WINDOW )
+        xTaskNotifyGive (_Task);
+    else
+        esp_timer_start_once (_Timer, wait);
+    }
+
+//#######################################################################
+void GATE_ENGINE_C::TimerFire (void* arg)
+    {
+    xTaskNotifyGive (((GATE_ENGINE_C*)arg)->_Task);
+    }
+
+//#######################################################################
+// Woken by the timer or a new earliest edge.  Holding the I2C lock
+// keeps the edges out of a flush in progress.  Update () releases the
+// lock between priorities so at worst an edge waits for the writes of
+// one priority.
+//#######################################################################
+void GATE_ENGINE_C::GateTask (void* arg)
+    {
+    GATE_ENGINE_C& eng = *(GATE_ENGINE_C*)arg;
+
+    for ( ;; )
+        {
+        ulTaskNotifyTake (pdTRUE, portMAX_DELAY);
+        I2cDevices.Lock ();
+        if ( eng.Apply (micros ()) > 0 )
+            {
+            I2cDevices.FlushGates ();
+            eng._Stats.Flushes++;
+            }
+        I2cDevices.Unlock ();
+        eng.Arm ();
+        }
+    }
+
+//#######################################################################
+// Call ahead of I2cDevices.Update () when not running from the timer.
+//#######################################################################
+void GATE_ENGINE_C::Loop ()
+    {
+    if ( _Task == nullptr && _Count > 0 )
+        Apply (micros ());
+    }
+
+//#######################################################################
+void GATE_ENGINE_C::GetStats (GATE_STATS_T& stats)
+    {
+    stats = _Stats;
+    }
+
+//#######################################################################
+void GATE_ENGINE_C::ResetStats ()
+    {
+    memset (&_Stats, 0, sizeof (_Stats));
+    }
+
+//#######################################################################
+void GATE_ENGINE_C::DumpStats ()
+    {
+    printf ("\n  Gates:  %u scheduled   %u sent   %u merged   %u dropped   %d pending\n",
+            _Stats.Scheduled, _Stats.Applied, _Stats.Merged, _Stats.Dropped, _Count);
+    printf ("          %s   %u timer flushes   %.3f mSec worst lateness\n",
+            ( _Task ) ? "timer" : "loop", _Stats.Flushes, _Stats.MaxLate * 0.001);
+    }
+
+//#######################################################################
+GATE_ENGINE_C GateEngine;
@@ -0,0 +1,74 @@
+//#######################################################################
+// Module:     Gates.h
+// Descrption: Timed gate and trigger edges for the digital outputs
+// Creator:    markeby
+// Date:       10/19/2026
+//#######################################################################
+#pragma once
+#include <esp_timer.h>
+
+#define GATE_QUEUE_DEPTH    64          // pending edges
+#define GATE_MERGE_WINDOW   50          // uSec.  Edges this close to due go out in the same board write
+#define GATE_TASK_PRIORITY  4           // above the I2C flush tasks
+#define GATE_TASK_STACK     3072
+
+//#######################################################################
+typedef struct
+    {
+    uint32_t    Time;           // micros () the edge is due
+    short       Device;         // digital output device
+    bool        State;
+    } GATE_EVENT_T;
+
+typedef struct
+    {
+    uint32_t    Scheduled;      // edges queued
+    uint32_t    Applied;        // edges sent
+    uint32_t    Merged;         // edges that shared a flush with an earlier edge
+    uint32_t    Dropped;        // edges refused because the queue was full
+    uint32_t    Flushes;        // gate flushes from the timer task
+    uint32_t    MaxLate;        // longest uSec an edge went out after its time
+    } GATE_STATS_T;
+
+//#######################################################################
+// Edges are kept in a queue sorted by time.  Without the timer they are
+// sent from Loop () so they go out with the next I2cDevices.Update ().
+// With the timer a high priority task wakes at each edge and writes just
+// the gate boards, so pulse widths no longer follow the loop rate.
+//#######################################################################
+class GATE_ENGINE_C
+    {
+private:
+    GATE_EVENT_T        _Queue[GATE_QUEUE_DEPTH];   // earliest first
+    int                 _Count;
+    portMUX_TYPE        _Spin;
+    GATE_STATS_T        _Stats;
+    TaskHandle_t        _Task;
+    esp_timer_handle_t  _Timer;
+
+    int  Insert             (short device, bool state, uint32_t at);
+    void Remove             (short device, uint32_t from);
+    int  Apply              (uint32_t now);
+    void Arm                (void);
+    static void TimerFire   (void* arg);
+    static void GateTask    (void* arg);
+
+public:
+         GATE_ENGINE_C  (void);
+    bool Begin          (bool timer);
+    void Loop           (void);
+    bool Schedule       (short device, bool state, uint32_t at);
+    bool Pulse          (short device, uint32_t width, uint32_t delay = 0);
+    void Cancel         (short device);
+    void CancelAll      (void);
+    void GetStats       (GATE_STATS_T& stats);
+    void ResetStats     (void);
+    void DumpStats      (void);
+
+    //#######################################################################
+    int Pending (void)
+        { return (_Count); }
+    };
+
+//#######################################################################
+extern GATE_ENGINE_C GateEngine;
@@ -12,25 +12,87 @@
 #include "I2Cdevices.h"
 #include "ADS1115.h"
 #include "Debug.h"
+#include "ZynthTime.h"
+#include "Trace.h"
+#include "Calibrate.h"
+#include "Slew.h"
+#include "Gates.h"
+
+#ifdef I2C_BATCH
+#include <driver/i2c.h>
+#endif
+#ifdef ESP_PLATFORM
+#include <esp_partition.h>
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+#define I2C_MMAP_HANDLE     esp_partition_mmap_handle_t
+#define I2C_MMAP_DATA       ESP_PARTITION_MMAP_DATA
+#define I2C_MUNMAP(h)       esp_partition_munmap (h)
+#else
+#define I2C_MMAP_HANDLE     spi_flash_mmap_handle_t
+#define I2C_MMAP_DATA       SPI_FLASH_MMAP_DATA
+#define I2C_MUNMAP(h)       spi_flash_munmap (h)
+#endif
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
-#ifdef DEBUG_SYNTH
 static const char* LabelDA = "I2C-DA";
 static const char* LabelAD = "I2C-AD";
 static const char* LabelDI = "I2C-DI";
 static const char* LabelMX = "I2C-MUX";
-#define DBGDA(args...) {if(_DebugI2C){DebugMsg(LabelDA,DEBUG_NO_INDEX,args);}}
-#define DBGAD(args...) {if(_DebugI2C){DebugMsg(LabelAD,DEBUG_NO_INDEX,args);}}
-#define DBGDIG(args...) {if(_DebugI2C){DebugMsg(LabelDI,DEBUG_NO_INDEX,args);}}
-#define DBGMUX(args...) {if(_DebugI2C){DebugMsg(LabelMX,DEBUG_NO_INDEX,args);}}
-#else
-#define DBGDA(args...)
-#define DBGAD(args...)
-#define DBGDIG(args...)
-#define DBGMUX(args...)
-#endif
+#define DBGDA(args...)  DEBUG_OUT (I2C_DA,  DLEVEL_DEBUG, DebugMsg (LabelDA, DEBUG_NO_INDEX, args))
+#define DBGAD(args...)  DEBUG_OUT (I2C_AD,  DLEVEL_DEBUG, DebugMsg (LabelAD, DEBUG_NO_INDEX, args))
+#define DBGDIG(args...) DEBUG_OUT (I2C_DIG, DLEVEL_DEBUG, DebugMsg (LabelDI, DEBUG_NO_INDEX, args))
+#define DBGMUX(args...) DEBUG_OUT (I2C_MUX, DLEVEL_DEBUG, DebugMsg (LabelMX, DEBUG_NO_INDEX, args))
+
 static const char* LabelError = "I2C";
-#define ERROR(args...) {ErrorMsg (LabelError, __FUNCTION__, args);}
-#define DBGERROR(args...) {if(_DebugI2C){ErrorMsg (LabelError, __FUNCTION__, args);}}
+#define ERROR(args...)    DEBUG_OUT (I2C, DLEVEL_ERROR, ErrorMsg (LabelError, __FUNCTION__, args))
+#define DBGERROR(args...) DEBUG_OUT (I2C, DLEVEL_INFO,  ErrorMsg (LabelError, __FUNCTION__, args))
+
+//#######################################################################
+// Driver registry in I2C_DRIVER order.  Adding a chip is an enum value,
+// a row here and its hooks.
+//#######################################################################
+#define I2C_HOOK(f)     &I2C_INTERFACE_C::f
+const I2C_INTERFACE_C::I2C_DRIVER_T I2C_INTERFACE_C::_Drivers[(int)I2C_DRIVER::COUNT] =
+    {
+    //  name          layout                    init                    flush                    read                  span                     bits                   D/A  A/D  dig
+    { "auto",       nullptr,                  nullptr,                nullptr,                 nullptr,              nullptr,                 nullptr,               0,   0,   0  },
+    { "MCP4728",    I2C_HOOK (Layout4728),    I2C_HOOK (Init4728),    I2C_HOOK (Write4728),    nullptr,              I2C_HOOK (SpanImage),    I2C_HOOK (BitsImage),  4,   0,   0  },
+    { "MCP47FXBX8", I2C_HOOK (Layout47FXBX8), I2C_HOOK (Init47FXBX8), I2C_HOOK (Write47FXBX8), nullptr,              I2C_HOOK (Span47FXBX8),  I2C_HOOK (BitsImage),  8,   0,   0  },
+    { "ADS1115",    I2C_HOOK (Layout1115),    I2C_HOOK (Init1115),    nullptr,                 I2C_HOOK (Read1115),  I2C_HOOK (SpanImage),    I2C_HOOK (Bits1115),   0,   4,   0  },
+    { "PCF857x",    I2C_HOOK (Layout857x),    I2C_HOOK (Init857x),    I2C_HOOK (Write857x),    I2C_HOOK (Read857x),  I2C_HOOK (SpanImage),    I2C_HOOK (BitsImage),  0,   0,   16 },
+    { "MCP23008",   I2C_HOOK (Layout23008),   I2C_HOOK (Init23008),   I2C_HOOK (Write23008),   I2C_HOOK (Read23008), I2C_HOOK (SpanImage),    I2C_HOOK (BitsImage),  0,   0,   8  },
+    };
+
+//#######################################################################
+// True if the channel counts fit the chip the driver is for
+//#######################################################################
+bool I2C_INTERFACE_C::DriverFits (I2C_DRIVER driver, int dtoa, int atod, int digital)
+    {
+    if ( driver == I2C_DRIVER::AUTO || driver >= I2C_DRIVER::COUNT )
+        return (false);
+
+    const I2C_DRIVER_T& drv = _Drivers[(int)driver];
+    return ((dtoa + atod + digital) > 0 && dtoa <= drv.DtoA && atod <= drv.AtoD && digital <= drv.Digital);
+    }
+
+//#######################################################################
+// How boards were identified before drivers were named:  four D/A is
+// an MCP4728, any other count an MCP47FXBX8.  Eight digital at 0x20 to
+// 0x27 is an MCP23008, any other digital board a PCF857x.
+//#######################################################################
+static I2C_DRIVER AutoDriver (I2C_LOCATION_T& loc)
+    {
+    if ( loc.NumberDtoA )
+        return (( loc.NumberDtoA == 4 ) ? I2C_DRIVER::MCP4728 : I2C_DRIVER::MCP47FXBX8);
+    if ( loc.NumberDigital )
+        return (( (loc.NumberDigital == 8) && ((loc.Port & 0xF8) == 0x20) ) ? I2C_DRIVER::MCP23008 : I2C_DRIVER::PCF857X);
+    return (I2C_DRIVER::ADS1115);
+    }
 
 //#######################################################################
 //#######################################################################
@@ -38,8 +100,115 @@ static const char* LabelError = "I2C";
     {
     _DebugI2C         = false;
     _CallbackAtoD     = nullptr;
+    _CallbackDigital  = nullptr;
+    _InputBoards      = 0;
+    _InputPeriod      = I2C_INPUT_PERIOD;
+    _InputTime        = 0;
+    _InputFull        = 0;
+    _InEvents         = 0;
+    _IntPin           = -1;
     _pBoard           = nullptr;
+    _pDevice          = nullptr;
+    _BoardCount       = 0;
+    _DeviceCount      = 0;
     _AtoD_loopDevice  = 0;
+    _AtoD_queued      = -1;
+    _BusesUsed        = 0;
+    _Parallel         = true;
+    _Batch            = true;
+    _Offline          = false;
+    _FastStart        = false;
+    _StartNext        = 0;
+    _pCaller          = nullptr;
+    _Lock             = nullptr;
+    _PrevTime         = 0;
+    memset (&_PrevTotal, 0, sizeof (_PrevTotal));
+    memset (&_Startup, 0, sizeof (_Startup));
+
+    static TwoWire* wires[I2C_BUS_COUNT] = { &Wire, &Wire1 };
+    for ( int z = 0;  z < I2C_BUS_COUNT;  z++ )
+        {
+        I2C_BUS_T& bus = _Bus[z];
+        memset (&bus, 0, sizeof (bus));
+        bus.pWire  = wires[z];
+        bus.Index  = z;
+        bus.Sda    = -1;
+        bus.Scl    = -1;
+        bus.Overhead = I2C_CALL_OVERHEAD << 4;
+        bus.Held   = -1;
+        bus.Task   = nullptr;
+        bus.pOwner = this;
+        }
+    }
+
+//#######################################################################
+// End a transmission and charge it to a counter block.  Wire time is
+// counted in bits: start, address, nine per data byte and stop.
+//#######################################################################
+uint8_t I2C_INTERFACE_C::EndTransmit (I2C_BUS_T& bus, I2C_COUNTERS_T& count, uint8_t bytes)
+    {
+    bus.LastEndT = bus.pWire->endTransmission (true);
+    bus.DriverCalls++;
+    count.Transactions++;
+    count.Bytes    += bytes;
+    count.WireBits += 2 + (9 * (bytes + 1));
+    switch ( bus.LastEndT )
+        {
+        case 0:
+            break;
+        case 2:
+            count.NackAddress++;
+            break;
+        case 3:
+            count.NackData++;
+            break;
+        case 5:
+            count.Timeouts++;
+            break;
+        default:
+            count.OtherErrors++;
+            break;
+        }
+    return (bus.LastEndT);
+    }
+
+//#######################################################################
+void I2C_INTERFACE_C::CountRead (I2C_COUNTERS_T& count, uint8_t received, uint8_t requested)
+    {
+    count.Transactions++;
+    count.Bytes    += received;
+    count.WireBits += 2 + (9 * (requested + 1));
+    if ( received < requested )
+        count.OtherErrors++;
+    }
+
+//#######################################################################
+static inline uint16_t TxWord (const uint8_t* ptx)
+    {
+    return ((ptx[0] << 8) | ptx[1]);
+    }
+
+//#######################################################################
+// Runtime state of one board from its location entry.  Corrections
+// go into the board's copy; the caller's table is left as given.
+//#######################################################################
+void I2C_INTERFACE_C::AddBoard (I2C_BOARD_T& brd, const I2C_LOCATION_T& loc)
+    {
+    brd.Board = loc;
+    if ( loc.Bus < 0 || loc.Bus >= I2C_BUS_COUNT )
+        {
+        printf ("\t****\tBus %d for \"%s\" is not available.  Using bus 0\n", loc.Bus, loc.Name);
+        brd.Board.Bus = 0;
+        }
+    if ( _Bus[brd.Board.Bus].BoardCount++ == 0 )
+        _BusesUsed++;
+    brd.Valid      = false;
+    brd.Recover    = false;
+    brd.Failures   = 0;
+    brd.ProbeDelay = I2C_PROBE_MIN;
+    brd.ProbeTime  = 0;
+    brd.DeferStart = 0;
+    memset (&brd.Count, 0, sizeof (I2C_COUNTERS_T));
     }
 
 //#######################################################################
@@ -56,119 +225,281 @@ void I2C_INTERFACE_C::BuildTables (I2C_LOCATION_T* plocation)
 
     for ( int z = 0;  z < _BoardCount;  z++ )
         {
-        I2C_LOCATION_T& loc = plocation[z];
-        _pBoard[z].Board    = loc;
-        _pBoard[z].Valid    = false;
+        const I2C_LOCATION_T& loc = plocation[z];
+        AddBoard (_pBoard[z], loc);
         _DeviceCount       += loc.NumberDtoA;
         _DeviceCount       += loc.NumberAtoD;
         _DeviceCount       += loc.NumberDigital;
         }
 
     _pDevice = new I2C_DEVICE_T[_DeviceCount];
+    LayoutTables ();
+    }
+
+//#######################################################################
+// The map already has the counts so both tables are allocated up front
+// and each record goes straight into its board.
+//#######################################################################
+bool I2C_INTERFACE_C::BuildTablesMap (const uint8_t* pmap)
+    {
+    const I2C_MAP_HEADER_T* phdr = (const I2C_MAP_HEADER_T*)pmap;
+    const I2C_MAP_BOARD_T*  prec = (const I2C_MAP_BOARD_T*)(pmap + sizeof (I2C_MAP_HEADER_T));
+    I2C_LOCATION_T          loc;
+
+    _BoardCount  = phdr->BoardCount;
+    _DeviceCount = phdr->DeviceCount;
+    _pBoard      = new I2C_BOARD_T[_BoardCount];
+    _pDevice     = new I2C_DEVICE_T[_DeviceCount];
+
+    for ( int z = 0;  z < _BoardCount;  z++, prec++ )
+        {
+        loc.Cluster       = prec->Cluster;
+        loc.Slice         = ( prec->Cluster < 0 ) ? 0 : prec->Slice;     // as a location table has it, calibration keys match
+        loc.Port          = prec->Port;
+        loc.NumberDtoA    = prec->NumberDtoA;
+        loc.NumberAtoD    = prec->NumberAtoD;
+        loc.NumberDigital = prec->NumberDigital;
+        loc.Name          = (const char*)(pmap + prec->NameOffset);
+        loc.Bus           = prec->Bus;
+        loc.MaxClock      = prec->MaxClock;
+        loc.Priority      = prec->Priority;
+        loc.InputMask     = prec->InputMask;
+        loc.Driver        = prec->Driver;
+        AddBoard (_pBoard[z], loc);
+        }
+
+    if ( LayoutTables () != _DeviceCount )
+        {
+        ERROR ("Board map device count does not match its boards");
+        return (false);
+        }
+    return (true);
+    }
 
+//#######################################################################
+// Resolve the driver of each board and lay out its channels.  Returns
+// the number of devices placed.
+//#######################################################################
+int I2C_INTERFACE_C::LayoutTables ()
+    {
     int at_dev = 0;
     for ( int zb = 0;  zb < _BoardCount;  zb++ )
         {
         I2C_BOARD_T& brd = _pBoard[zb];
         brd.NewDataMask = 0;
-        if ( brd.Board.NumberDtoA )
+        brd.TxLength    = 0;
+        brd.FirstDevice = at_dev;
+        brd.InRaw       = 0;
+        brd.InStable    = 0;
+        brd.InPending   = 0;
+        memset (brd.InSince, 0, sizeof (brd.InSince));
+        memset (brd.Tx, 0, sizeof (brd.Tx));
+        brd.Priority    = brd.Board.Priority;
+        if ( brd.Priority == I2C_PRIORITY::AUTO || brd.Priority >= I2C_PRIORITY::COUNT )
             {
-            brd.BoardType = ( brd.Board.NumberDtoA == 4 ) ? MCP4728 : MCP47FXBX8;
-            brd.DataDtoA[0] = 0;
-            brd.DataDtoA[1] = 0;
-            for ( int zd = 0;  zd < brd.Board.NumberDtoA;  zd++, at_dev++ )
-                {
-                _pDevice[at_dev].pBoard   = &(_pBoard[zb]);
-                _pDevice[at_dev].pDtoA    = &(brd.DtoA[zd]);
-                _pDevice[at_dev].DevIndex = zd;
-                }
+            if ( brd.Board.NumberDigital )
+                brd.Priority = I2C_PRIORITY::GATE;
+            else if ( brd.Board.NumberDtoA )
+                brd.Priority = I2C_PRIORITY::MOD;
+            else
+                brd.Priority = I2C_PRIORITY::ATOD;
             }
-
-        else if ( brd.Board.NumberDigital )
+        if ( brd.Board.Driver == I2C_DRIVER::AUTO || brd.Board.Driver >= I2C_DRIVER::COUNT )
+            brd.Board.Driver = AutoDriver (brd.Board);
+        else if ( !DriverFits (brd.Board.Driver, brd.Board.NumberDtoA, brd.Board.NumberAtoD, brd.Board.NumberDigital) )
             {
-            brd.BoardType = ( (brd.Board.NumberDigital == 8) && ((brd.Board.Port & 0xF8) == 0x20) ) ? MCP23008 : PCF8575;
-            brd.DataDigital = 0;
-            for ( int zd = 0;  zd < brd.Board.NumberDigital;  zd++, at_dev++ )
-                {
-                _pDevice[at_dev].pBoard   = &(_pBoard[zb]);
-                _pDevice[at_dev].pDigital = &(brd.DataDigital);
-                _pDevice[at_dev].DevIndex = zd;
-                }
+            ERROR ("%s cannot carry the channels of \"%s\".  Using the board's default driver", _Drivers[(int)brd.Board.Driver].Name, brd.Board.Name);
+            brd.Board.Driver = AutoDriver (brd.Board);
             }
+        if ( brd.Board.NumberDigital == 0 )
+            brd.Board.InputMask = 0;
+        brd.pDriver = &_Drivers[(int)brd.Board.Driver];
+        if ( at_dev + brd.Board.NumberDtoA + brd.Board.NumberAtoD + brd.Board.NumberDigital > _DeviceCount )
+            break;                                      // map that does not add up, stop before overrunning
+        (this->*brd.pDriver->Layout) (brd, at_dev);
+        if ( brd.Board.InputMask )
+            _InputBoards++;
+        }
+    return (at_dev);
+    }
 
-        else if ( brd.Board.NumberAtoD )
-            {
-            brd.BoardType = ADS1115;
-            brd.DataAtoD = 0;
-            for ( int zd = 0;  zd < brd.Board.NumberAtoD;  zd++, at_dev++ )
-                {
-                _pDevice[at_dev].pBoard   = &(_pBoard[zb]);
-                _pDevice[at_dev].pAtoD    = &(brd.AtoD[zd]);
-                _pDevice[at_dev].DtoAain  = DecodeIndex1115 (zd);
-                _pDevice[at_dev].DevIndex = zd;
-                }
-            }
+//#######################################################################
+// Frees the tables and forgets every board so a new map can be loaded.
+// Bus pins, clocks, budgets and tasks are kept.
+//#######################################################################
+void I2C_INTERFACE_C::Release ()
+    {
+    delete[] _pBoard;
+    delete[] _pDevice;
+    _pBoard          = nullptr;
+    _pDevice         = nullptr;
+    _BoardCount      = 0;
+    _DeviceCount     = 0;
+    _StartNext       = 0;
+    _BusesUsed       = 0;
+    _InputBoards     = 0;
+    _AtoD_loopDevice = 0;
+    _AtoD_queued     = -1;
+    for ( int z = 0;  z < I2C_BUS_COUNT;  z++ )
+        {
+        _Bus[z].BoardCount = 0;
+        memset (_Bus[z].Next, 0, sizeof (_Bus[z].Next));
+        }
+    }
+
+//#######################################################################
+// Transmit image layouts.  Each driver places its channels in the image
+// and points the devices at their bytes.
+//#######################################################################
+void I2C_INTERFACE_C::LayoutDtoA (I2C_BOARD_T& brd, int& at_dev, int step)
+    {
+    for ( int zd = 0;  zd < brd.Board.NumberDtoA;  zd++, at_dev++ )
+        {
+        uint8_t* ptx = &brd.Tx[zd * step];
+        if ( step == 3 )
+            *ptx++ = zd << 3;
+        _pDevice[at_dev].pBoard   = &brd;
+        _pDevice[at_dev].pDtoA    = ptx;
+        _pDevice[at_dev].DevIndex = zd;
+        }
+    brd.TxLength = brd.Board.NumberDtoA * step;
+    }
+
+//#######################################################################
+// MCP47FXBX8:  per channel, write command then data high and low
+void I2C_INTERFACE_C::Layout47FXBX8 (I2C_BOARD_T& brd, int& at_dev)
+    {
+    LayoutDtoA (brd, at_dev, 3);
+    }
+
+//#######################################################################
+// MCP4728:  fast write, data high (command bits zero) and low per channel
+void I2C_INTERFACE_C::Layout4728 (I2C_BOARD_T& brd, int& at_dev)
+    {
+    LayoutDtoA (brd, at_dev, 2);
+    }
+
+//#######################################################################
+void I2C_INTERFACE_C::LayoutDigital (I2C_BOARD_T& brd, int& at_dev, int base)
+    {
+    for ( int zd = 0;  zd < brd.Board.NumberDigital;  zd++, at_dev++ )
+        {
+        _pDevice[at_dev].pBoard   = &brd;
+        _pDevice[at_dev].pDigital = &brd.Tx[base + (zd >> 3)];
+        _pDevice[at_dev].DevIndex = zd;
+        }
+    brd.TxLength = base + ((brd.Board.NumberDigital + 7) >> 3);
+
+    // Input pins are held at one in the image.  That is the weak
+    // pull up on a PCF857x and input direction on an MCP23008.
+    brd.Board.InputMask &= (uint16_t)((1UL << brd.Board.NumberDigital) - 1);
+    brd.Tx[base] |= brd.Board.InputMask & 0xFF;
+    if ( brd.Board.NumberDigital > 8 )
+        brd.Tx[base + 1] |= brd.Board.InputMask >> 8;
+    }
+
+//#######################################################################
+// PCF857x:  port bytes, low first
+void I2C_INTERFACE_C::Layout857x (I2C_BOARD_T& brd, int& at_dev)
+    {
+    LayoutDigital (brd, at_dev, 0);
+    }
+
+//#######################################################################
+// MCP23008:  register address then port byte
+void I2C_INTERFACE_C::Layout23008 (I2C_BOARD_T& brd, int& at_dev)
+    {
+    LayoutDigital (brd, at_dev, 1);
+    }
+
+//#######################################################################
+void I2C_INTERFACE_C::Layout1115 (I2C_BOARD_T& brd, int& at_dev)
+    {
+    brd.DataAtoD = 0;
+    for ( int zd = 0;  zd < brd.Board.NumberAtoD;  zd++, at_dev++ )
+        {
+        _pDevice[at_dev].pBoard   = &brd;
+        _pDevice[at_dev].pAtoD    = &(brd.AtoD[zd]);
+        _pDevice[at_dev].DtoAain  = DecodeIndex1115 (zd);
+        _pDevice[at_dev].DevIndex = zd;
         }
     }
 
 //#######################################################################
 void I2C_INTERFACE_C::BusMux (I2C_LOCATION_T& loc)
     {
+    I2C_BUS_T& bus = _Bus[loc.Bus];
+
     if ( loc.Cluster < 0 )
         return;
+    if ( bus.Held == loc.Cluster )                      // slice already selected for a grouped Init
+        {
+        bus.LastEndT = 0;
+        return;
+        }
+    TRACE_SCOPE (I2C_BUSMUX, (loc.Cluster << 8) | loc.Slice);
     DBGMUX ("Selecting cluster %d with slice %d", loc.Cluster, loc.Slice);
-    Wire.beginTransmission (0x70 + loc.Cluster);    // TCA9548A address
-    Wire.write (1 << loc.Slice);                    // send byte to select bus
-    _LastEndT = Wire.endTransmission();
-    if ( _LastEndT )
-        ERROR ("BusMux cluster %d select %d with error: %s", loc.Cluster, loc.Slice, ErrorStringI2C (_LastEndT));
+    bus.pWire->beginTransmission (0x70 + loc.Cluster);    // TCA9548A address
+    bus.pWire->write (1 << loc.Slice);                    // send byte to select bus
+    EndTransmit (bus, bus.MuxCount, 1);
+    if ( bus.LastEndT )
+        ERROR ("BusMux cluster %d select %d with error: %s", loc.Cluster, loc.Slice, ErrorStringI2C (bus.LastEndT));
     }
 
 //#######################################################################
 void I2C_INTERFACE_C::EndBusMux (I2C_LOCATION_T& loc)
     {
-    if ( loc.Cluster < 0 )
+    I2C_BUS_T& bus = _Bus[loc.Bus];
+
+    if ( loc.Cluster < 0 || bus.Held >= 0 )
         return;
     DBGMUX ("Deselecting cluster %d", loc.Cluster);
-    Wire.beginTransmission (0x70 + loc.Cluster);    // TCA9548A address
-    Wire.write (0);                                 // send byte to deselect bus
-    _LastEndT = Wire.endTransmission();
-    if ( _LastEndT )
-        ERROR ("Ending cluster %d  slice: %d   error: %s", loc.Cluster, loc.Slice, ErrorStringI2C (_LastEndT));
+    bus.pWire->beginTransmission (0x70 + loc.Cluster);    // TCA9548A address
+    bus.pWire->write (0);                                 // send byte to deselect bus
+    EndTransmit (bus, bus.MuxCount, 1);
+    if ( bus.LastEndT )
+        ERROR ("Ending cluster %d  slice: %d   error: %s", loc.Cluster, loc.Slice, ErrorStringI2C (bus.LastEndT));
     }
 
 //#######################################################################
 bool I2C_INTERFACE_C::ValidateDevice (ushort board)
     {
     I2C_BOARD_T& brd = _pBoard[board];
+    I2C_BUS_T&   bus = _Bus[brd.Board.Bus];
     brd.Valid = false;
+    SetBusClock (bus, brd.Clock);
     BusMux (brd.Board);
-    Wire.beginTransmission(brd.Board.Port);
+    bus.pWire->beginTransmission(brd.Board.Port);
 
-    _LastEndT = Wire.endTransmission (true);
-    if ( _LastEndT == 0 )
+    EndTransmit (bus, brd.Count, 0);
+    if ( bus.LastEndT == 0 )
         brd.Valid = true;
     else
-        DBGERROR ("Validation error on port %#02.2X.  %s", brd.Board.Port, ErrorStringI2C (_LastEndT));
+        DBGERROR ("Validation error on port %#02.2X.  %s", brd.Board.Port, ErrorStringI2C (bus.LastEndT));
 
     EndBusMux (brd.Board);
     return (!brd.Valid);
     }
 
 //#######################################################################
-uint16_t I2C_INTERFACE_C::ReadRegister16 (uint8_t port, uint8_t addr)
+uint16_t I2C_INTERFACE_C::ReadRegister16 (I2C_BOARD_T& brd, uint8_t addr)
     {
+    I2C_BUS_T& bus  = _Bus[brd.Board.Bus];
+    uint8_t    port = brd.Board.Port;
+
+    TRACE_SCOPE (I2C_READ16, (port << 8) | addr);
     DBGAD ("Setup to read at port %#02.2x for addr %#02.2x", port, addr);
-    Wire.beginTransmission (port);
-    Wire.write (addr);
-    _LastEndT = Wire.endTransmission (true);
-    if ( _LastEndT )
-        ERROR ("Cannot issue read request to port: %#02.2X   addr: %#02.2X   error: %s", port, addr, ErrorStringI2C (_LastEndT));
-    Wire.requestFrom(port, (uint8_t)2, true);
-    if ( Wire.available () )
-        {
-        uint16_t data = Wire.read () << 8;
-        data |= Wire.read ();
+    bus.pWire->beginTransmission (port);
+    bus.pWire->write (addr);
+    EndTransmit (bus, brd.Count, 1);
+    if ( bus.LastEndT )
+        ERROR ("Cannot issue read request to port: %#02.2X   addr: %#02.2X   error: %s", port, addr, ErrorStringI2C (bus.LastEndT));
+    Health (brd, bus.LastEndT);
+    CountRead (brd.Count, bus.pWire->requestFrom (port, (uint8_t)2, true), 2);
+    if ( bus.pWire->available () )
+        {
+        uint16_t data = bus.pWire->read () << 8;
+        data |= bus.pWire->read ();
         DBGAD ("Success in read data %#04.4x", data);
         return (data);
         }
@@ -177,53 +508,65 @@ uint16_t I2C_INTERFACE_C::ReadRegister16 (uint8_t port, uint8_t addr)
     }
 
 //#######################################################################
-void I2C_INTERFACE_C::Write (I2C_LOCATION_T &loc, uint8_t* buff, uint8_t length)
+void I2C_INTERFACE_C::Write (I2C_BOARD_T& brd, uint8_t* buff, uint8_t length)
     {
-    int rval;
+    I2C_LOCATION_T& loc = brd.Board;
+    I2C_BUS_T&      bus = _Bus[loc.Bus];
+
     BusMux (loc);
-    Wire.beginTransmission (loc.Port);
-    Wire.write (buff, length);
-    _LastEndT = Wire.endTransmission (true);
+    bus.pWire->beginTransmission (loc.Port);
+    bus.pWire->write (buff, length);
+    uint8_t err = EndTransmit (bus, brd.Count, length);      // the mux release below replaces LastEndT
     EndBusMux (loc);
-    if ( _LastEndT )
+    if ( err )
         {
-        ERROR ("Result: %s   cluster: %d   slice: %d   port: 0x%#02.2X   buff[0]: 0x%#02.2X   length: %d", ErrorStringI2C (_LastEndT), loc.Cluster, loc.Slice, loc.Port, *buff, length);
+        ERROR ("Result: %s   cluster: %d   slice: %d   port: 0x%#02.2X   buff[0]: 0x%#02.2X   length: %d", ErrorStringI2C (err), loc.Cluster, loc.Slice, loc.Port, *buff, length);
         }
+    Health (brd, err);
     }
 
 //#######################################################################
-void I2C_INTERFACE_C::WriteByte (uint8_t port, uint8_t data)
+void I2C_INTERFACE_C::WriteByte (I2C_BOARD_T& brd, uint8_t data)
     {
-    Wire.beginTransmission (port);
-    Wire.write (data);
-    _LastEndT = Wire.endTransmission (true);
-    if ( _LastEndT )
-        ERROR ("Port: %#02.2X   data: %#02.2X   error: %s", port, data, ErrorStringI2C (_LastEndT));
+    I2C_BUS_T& bus  = _Bus[brd.Board.Bus];
+    uint8_t    port = brd.Board.Port;
+
+    bus.pWire->beginTransmission (port);
+    bus.pWire->write (data);
+    EndTransmit (bus, brd.Count, 1);
+    if ( bus.LastEndT )
+        ERROR ("Port: %#02.2X   data: %#02.2X   error: %s", port, data, ErrorStringI2C (bus.LastEndT));
     }
 
 //#######################################################################
-void I2C_INTERFACE_C::WriteRegisterByte (uint8_t port, uint8_t addr, uint8_t data)
+void I2C_INTERFACE_C::WriteRegisterByte (I2C_BOARD_T& brd, uint8_t addr, uint8_t data)
     {
+    I2C_BUS_T& bus  = _Bus[brd.Board.Bus];
+    uint8_t    port = brd.Board.Port;
+
     DBGAD ("Sending to port %#02.2x for addr %#02.2x with data %#04.4x", port, addr, data);
-    Wire.beginTransmission (port);
-    Wire.write (addr);
-    Wire.write (data);
-    _LastEndT = Wire.endTransmission (true);
-    if ( _LastEndT )
-        ERROR ("Result: %s   port: %#02.2x   addr: %#02.2x   data: %#04.4x", ErrorStringI2C (_LastEndT), port, addr, data);
+    bus.pWire->beginTransmission (port);
+    bus.pWire->write (addr);
+    bus.pWire->write (data);
+    EndTransmit (bus, brd.Count, 2);
+    if ( bus.LastEndT )
+        ERROR ("Result: %s   port: %#02.2x   addr: %#02.2x   data: %#04.4x", ErrorStringI2C (bus.LastEndT), port, addr, data);
     }
 
 //#######################################################################
-void I2C_INTERFACE_C::WriteRegisterWord (uint8_t port, uint8_t addr, uint16_t data)
+void I2C_INTERFACE_C::WriteRegisterWord (I2C_BOARD_T& brd, uint8_t addr, uint16_t data)
     {
+    I2C_BUS_T& bus  = _Bus[brd.Board.Bus];
+    uint8_t    port = brd.Board.Port;
+
     DBGAD ("Sending to port %#02.2x for addr %#02.2x with data %#04.4x", port, addr, data);
-    Wire.beginTransmission (port);
-    Wire.write (addr);
-    Wire.write ((uint8_t)(data >> 8));
-    Wire.write ((uint8_t)(data &  0xFF));
-    _LastEndT = Wire.endTransmission (true);
-    if ( _LastEndT )
-        ERROR ("Result: %s   port: %#02.2x   addr: %#02.2x   data: %#04.4x", ErrorStringI2C (_LastEndT), port, addr, data);
+    bus.pWire->beginTransmission (port);
+    bus.pWire->write (addr);
+    bus.pWire->write ((uint8_t)(data >> 8));
+    bus.pWire->write ((uint8_t)(data &  0xFF));
+    EndTransmit (bus, brd.Count, 3);
+    if ( bus.LastEndT )
+        ERROR ("Result: %s   port: %#02.2x   addr: %#02.2x   data: %#04.4x", ErrorStringI2C (bus.LastEndT), port, addr, data);
     }
 
 //#######################################################################
@@ -234,91 +577,108 @@ uint8_t I2C_INTERFACE_C::DecodeIndex1115 (uint8_t index)
     }
 
 //#######################################################################
-void I2C_INTERFACE_C::Init47FXBX8 (I2C_LOCATION_T &loc)
+void I2C_INTERFACE_C::Init47FXBX8 (I2C_BOARD_T& brd)
     {
+    I2C_LOCATION_T& loc = brd.Board;
+    I2C_BUS_T&      bus = _Bus[loc.Bus];
     static uint8_t p = 0x09 << 3;       // value for volitaile power down
     static uint8_t r = 0x08 << 3;       // value for volitaile Vref
     static uint8_t g = 0x0A << 3;       // value for volitaile gain
 
     BusMux (loc);
-    if ( _LastEndT )
+    if ( bus.LastEndT )
         {
-        ERROR ("Accessing cluster %d to enable slice %d   error: %s", loc.Cluster, loc.Slice, ErrorStringI2C (_LastEndT));
+        ERROR ("Accessing cluster %d to enable slice %d   error: %s", loc.Cluster, loc.Slice, ErrorStringI2C (bus.LastEndT));
         }
-    WriteRegisterWord (loc.Port, p, 0x0000);
-    WriteRegisterWord (loc.Port, r, 0x0000);;
-    WriteRegisterWord (loc.Port, g, 0x0000);;
+    WriteRegisterWord (brd, p, 0x0000);
+    WriteRegisterWord (brd, r, 0x0000);;
+    WriteRegisterWord (brd, g, 0x0000);;
     // reset all D/A to zero
     for ( int z = 0;  z < 8;  z++ )
-        WriteRegisterWord (loc.Port, z << 3, 0x0000);
+        WriteRegisterWord (brd, z << 3, 0x0000);
     EndBusMux (loc);
     }
 
 //#######################################################################
-void I2C_INTERFACE_C::Init4728 (I2C_LOCATION_T &loc)
+void I2C_INTERFACE_C::Init4728 (I2C_BOARD_T& brd)
     {
+    I2C_LOCATION_T& loc = brd.Board;
+    I2C_BUS_T&      bus = _Bus[loc.Bus];
     static uint8_t p = 0xA0;        // value for power down
     static uint8_t r = 0x80;        // value for Vref
     static uint8_t g = 0xC0;        // value for gain
     static uint8_t d[8] = {0, 0, 0, 0, 0, 0, 0, 0 };
 
     BusMux (loc);
-    if ( _LastEndT )
+    if ( bus.LastEndT )
         {
-        ERROR ("Accessing cluster %d to enable slice %d   error: %s", loc.Cluster, loc.Slice, ErrorStringI2C (_LastEndT));
+        ERROR ("Accessing cluster %d to enable slice %d   error: %s", loc.Cluster, loc.Slice, ErrorStringI2C (bus.LastEndT));
         }
-    WriteByte (loc.Port, p);
-    WriteByte (loc.Port, r);
-    WriteByte (loc.Port, g);
-    Wire.beginTransmission (loc.Port);      // reset all D/A to zero
-    Wire.write (d, 8);
-    _LastEndT = Wire.endTransmission (true);
+    WriteByte (brd, p);
+    WriteByte (brd, r);
+    WriteByte (brd, g);
+    bus.pWire->beginTransmission (loc.Port);      // reset all D/A to zero
+    bus.pWire->write (d, 8);
+    EndTransmit (bus, brd.Count, 8);
 
     EndBusMux (loc);
     }
 
 //#######################################################################
-void I2C_INTERFACE_C::Init857x (I2C_LOCATION_T &loc)
+void I2C_INTERFACE_C::Init857x (I2C_BOARD_T& brd)
     {
-    static uint8_t d[2] = {0, 0 };
+    I2C_LOCATION_T& loc = brd.Board;
+    I2C_BUS_T&      bus = _Bus[loc.Bus];
+    uint8_t         d[2] = { (uint8_t)(loc.InputMask & 0xFF), (uint8_t)(loc.InputMask >> 8) };
 
     BusMux (loc);
-    Wire.beginTransmission (loc.Port);      // reset all D/A to zero
-    Wire.write (d, 2);
-    _LastEndT = Wire.endTransmission (true);
+    bus.pWire->beginTransmission (loc.Port);      // reset all outputs to zero and release the inputs
+    bus.pWire->write (d, 2);
+    EndTransmit (bus, brd.Count, 2);
 
     EndBusMux (loc);
     }
 
 //#######################################################################
-void I2C_INTERFACE_C::Init23008 (I2C_LOCATION_T &loc)
+void I2C_INTERFACE_C::Init23008 (I2C_BOARD_T& brd)
     {
-    static uint8_t d[4][2] = {{ 0x05, 0x20 },   // turn off sequential addressng
-                              { 0x0A, 0x00 },   // outuput latches
-                              { 0x06, 0xFF },   // Enable pullup resistors
-                              { 0x00, 0x00 },   // Ouput direction
-                             };
+    I2C_LOCATION_T& loc = brd.Board;
+
+    uint8_t d[5][2] = {{ 0x05, 0x20 },   // turn off sequential addressng
+                       { 0x0A, 0x00 },   // outuput latches
+                       { 0x06, 0xFF },   // Enable pullup resistors
+                       { 0x00, 0x00 },   // Ouput direction
+                       { 0x02, 0x00 },   // interrupt on change
+                      };
+    uint8_t inputs = loc.InputMask & 0xFF;
+
+    d[3][1] = inputs;
+    if ( _IntPin >= 0 )
+        {
+        d[0][1] |= 0x04;                // open drain INT so boards can share one line
+        d[4][1]  = inputs;
+        }
     BusMux (loc);
-    for ( int z = 0;  z < 4;  z++ )
-        WriteRegisterByte (loc.Port, d[z][0], d[z][1]);
+    for ( int z = 0;  z < 5;  z++ )
+        WriteRegisterByte (brd, d[z][0], d[z][1]);
     EndBusMux (loc);
     }
 
 //#######################################################################
-void I2C_INTERFACE_C::Init1115 (I2C_LOCATION_T &loc)
+void I2C_INTERFACE_C::Init1115 (I2C_BOARD_T& brd)
     {
+    I2C_LOCATION_T& loc = brd.Board;
+
     BusMux (loc);
-    WriteRegisterWord (loc.Port, ADS1115_CONFIG_REG_ADDR, ADS1115_CONFIG_REG_DEF & ~(1 << ADS1115_OS_FLAG_POS));
-    WriteRegisterWord (loc.Port, ADS1115_LOW_TRESH_REG_ADDR, ADS1115_LOW_TRESH_REG_DEF);
-    WriteRegisterWord (loc.Port, ADS1115_HIGH_TRESH_REG_ADDR, ADS1115_HIGH_TRESH_REG_DEF);
+    WriteRegisterWord (brd, ADS1115_CONFIG_REG_ADDR, ADS1115_CONFIG_REG_DEF & ~(1 << ADS1115_OS_FLAG_POS));
+    WriteRegisterWord (brd, ADS1115_LOW_TRESH_REG_ADDR, ADS1115_LOW_TRESH_REG_DEF);
+    WriteRegisterWord (brd, ADS1115_HIGH_TRESH_REG_ADDR, ADS1115_HIGH_TRESH_REG_DEF);
     EndBusMux (loc);
-    _AtoD_loopDevice = 0;
     }
 
 //#######################################################################
 void I2C_INTERFACE_C::Start1115 (I2C_DEVICE_T& device)
     {
-    I2C_LOCATION_T& loc = device.pBoard->Board;
     uint16_t val =
           (ADS1115_OS_START_SINGLE       << ADS1115_OS_FLAG_POS)        \
        |  (device.DtoAain                << ADS1115_MUX0_DAT_POS)       \
@@ -330,63 +690,68 @@ void I2C_INTERFACE_C::Start1115 (I2C_DEVICE_T& device)
        |  (ADS1115_COMP_LAT_NO_LATCH     << ADS1115_COMP_LAT_FLAG_POS)  \
        |  (ADS1115_COMP_QUE_DISABLE      << ADS1115_COMP_QUE0_DAT_POS);
 
-    WriteRegisterWord (loc.Port, ADS1115_CONFIG_REG_ADDR, val);
+    WriteRegisterWord (*device.pBoard, ADS1115_CONFIG_REG_ADDR, val);
     }
 
 //#######################################################################
 void I2C_INTERFACE_C::Write47FXBX8 (I2C_BOARD_T& board)
     {
-    uint8_t buf[32];
     I2C_LOCATION_T& loc =  board.Board;
 
     if ( ! board.Valid )
         return;
 
-//    DBGDA ("%d:%d:%#3.3x%c write  %#4.4d  %#4.4d  %#4.4d  %#4.4d  %#4.4d  %#4.4d  %#4.4d  %#4.4d  %s",
-//           loc.Cluster, loc.Slice, loc.Port,
-//           (( board.Valid ) ? ' ' : '-'),
-//           board.DtoA[0], board.DtoA[1], board.DtoA[2], board.DtoA[3], board.DtoA[4], board.DtoA[5], board.DtoA[6], board.DtoA[7], loc.Name);
+    uint8_t* ptx;
+    uint8_t  length = TxSpan (board, ptx);
 
-    // Only update thos registers that have changed.
-    int bufsize = 0;
-    for ( int z = 0;  z < 8;  z++ )
+    for ( uint8_t* p = ptx;  p < ptx + length;  p += 3 )
         {
-        if ( board.NewDataMask & (1 << z) )
-            {
-            DBGDA ("%d:%d:%#3.3x%c write chan %d data %#4.4d", loc.Cluster, loc.Slice, loc.Port,
-                   (( board.Valid ) ? ' ' : '-'), z, board.DtoA[z]);
-
-            buf[bufsize++] = z << 3;
-            buf[bufsize++] = board.ByteData[(z * 2) + 1];
-            buf[bufsize++] = board.ByteData[(z * 2)];
-            }
+        DBGDA ("%d:%d:%#3.3x%c write chan %d data %#4.4d", loc.Cluster, loc.Slice, loc.Port,
+               (( board.Valid ) ? ' ' : '-'), p[0] >> 3, TxWord (p + 1));
         }
-    Write (loc, buf, bufsize);
+    Write (board, ptx, length);
+    }
+
+//#######################################################################
+// The part of the transmit image a flush has to send.  The MCP47FXBX8
+// only sends the span of channels from the first to the last that
+// changed, everything else sends the whole image.
+//#######################################################################
+uint8_t I2C_INTERFACE_C::TxSpan (I2C_BOARD_T& brd, uint8_t*& ptx)
+    {
+    return ((this->*brd.pDriver->Span) (brd, ptx));
+    }
+
+//#######################################################################
+uint8_t I2C_INTERFACE_C::SpanImage (I2C_BOARD_T& brd, uint8_t*& ptx)
+    {
+    ptx = brd.Tx;
+    return (brd.TxLength);
+    }
+
+//#######################################################################
+uint8_t I2C_INTERFACE_C::Span47FXBX8 (I2C_BOARD_T& brd, uint8_t*& ptx)
+    {
+    int first = __builtin_ctz (brd.NewDataMask);
+    int last  = 31 - __builtin_clz ((uint32_t)brd.NewDataMask);
+    ptx = &brd.Tx[first * 3];
+    return ((last - first + 1) * 3);
     }
 
 //#######################################################################
 void I2C_INTERFACE_C::Write4728 (I2C_BOARD_T& board)
     {
-    uint8_t buf[8];
     I2C_LOCATION_T& loc =  board.Board;
 
     DBGDA ("%d:%d:%#3.3x%c write  %#4.4d  %#4.4d  %#4.4d  %#4.4d  %s",
            loc.Cluster, loc.Slice, loc.Port,
            (( board.Valid ) ? ' ' : '-'),
-           board.DtoA[0], board.DtoA[1], board.DtoA[2], board.DtoA[3], loc.Name);
+           TxWord (&board.Tx[0]), TxWord (&board.Tx[2]), TxWord (&board.Tx[4]), TxWord (&board.Tx[6]), loc.Name);
 
     // This quad DAC does not have a simple access to only
     // registers that need updating so update them all.
-    buf[0] = board.ByteData[1];
-    buf[1] = board.ByteData[0];
-    buf[2] = board.ByteData[3];
-    buf[3] = board.ByteData[2];
-    buf[4] = board.ByteData[5];
-    buf[5] = board.ByteData[4];
-    buf[6] = board.ByteData[7];
-    buf[7] = board.ByteData[6];
     if ( board.Valid )
-        Write (loc, buf, 8);
+        Write (board, board.Tx, board.TxLength);
     }
 
 //#######################################################################
@@ -394,12 +759,12 @@ void I2C_INTERFACE_C::Write857x (I2C_BOARD_T& board)
     {
     I2C_LOCATION_T& loc =  board.Board;
 
-#ifdef DEBUG_SYNTH
+#if DEBUG_LEVEL_I2C_DIG >= DLEVEL_DEBUG
     String str;
-    if ( _DebugI2C )
+    if ( DebugOn (DMODULE::I2C_DIG, DLEVEL_DEBUG) )
         {
-        for (uint8_t z;  z < board.Board.NumberDigital;  z++)
-            str += ( ((board.BitWord >> z) & 1) ) ? " 1" : " 0";
+        for (uint8_t z = 0;  z < board.Board.NumberDigital;  z++)
+            str += ( ((board.Tx[z >> 3] >> (z & 7)) & 1) ) ? " 1" : " 0";
         }
     DBGDIG ("%d:%d:%#3.3x%c write %s  %s",
             loc.Cluster, loc.Slice, loc.Port,
@@ -408,10 +773,8 @@ void I2C_INTERFACE_C::Write857x (I2C_BOARD_T& board)
             loc.Name);
 #endif
 
-    if ( board.Board.NumberDigital == 8 )       // if device is a 8574
-        board.ByteData[1] = board.ByteData[0];
     if ( board.Valid )
-        Write(loc, board.ByteData, 2);
+        Write (board, board.Tx, board.TxLength);
     }
 
 //#######################################################################
@@ -419,12 +782,12 @@ void I2C_INTERFACE_C::Write23008 (I2C_BOARD_T& board)
     {
     I2C_LOCATION_T& loc =  board.Board;
 
-#ifdef DEBUG_SYNTH
+#if DEBUG_LEVEL_I2C_DIG >= DLEVEL_DEBUG
     String str;
-    if ( _DebugI2C )
+    if ( DebugOn (DMODULE::I2C_DIG, DLEVEL_DEBUG) )
         {
-        for (uint8_t z;  z < board.Board.NumberDigital;  z++)
-            str += ( ((board.BitWord >> z) & 1) ) ? " 1" : " 0";
+        for (uint8_t z = 0;  z < board.Board.NumberDigital;  z++)
+            str += ( ((board.Tx[1] >> z) & 1) ) ? " 1" : " 0";
         }
     DBGDIG ("%d:%d:%#3.3x%c write %s  %s",
             loc.Cluster, loc.Slice, loc.Port,
@@ -433,216 +796,2125 @@ void I2C_INTERFACE_C::Write23008 (I2C_BOARD_T& board)
             loc.Name);
 #endif
 
-    static uint8_t d[2] = { 0, 0 };
-    d[1] = board.ByteData[0];
-    Write(loc, d, 2);
+    Write (board, board.Tx, board.TxLength);
     }
 
 //#######################################################################
+void I2C_INTERFACE_C::InitBoard (I2C_BOARD_T& brd)
+    {
+    SetBusClock (_Bus[brd.Board.Bus], brd.Clock);
+    (this->*brd.pDriver->Init) (brd);
+    PrimeInputs (brd);
+    }
+
 //#######################################################################
-// return:  0 = all good
-//         -1 = Total failure
-//         +X = Some interface errors
-int I2C_INTERFACE_C::Begin (I2C_LOCATION_T* p_location, uint64_t clock)
+// Start from the pins as they are so nothing is reported at boot
+//#######################################################################
+void I2C_INTERFACE_C::PrimeInputs (I2C_BOARD_T& brd)
     {
-    String  str;
-    uint8_t err = 0;
+    if ( brd.Board.InputMask )
+        {
+        uint16_t now = millis ();
+
+        BusMux (brd.Board);
+        brd.InRaw     = ReadInputs (brd);
+        brd.InStable  = brd.InRaw;
+        brd.InPending = 0;
+        for ( int z = 0;  z < 16;  z++ )
+            brd.InSince[z] = now;
+        EndBusMux (brd.Board);
+        }
+    }
 
-    BuildTables (p_location);
+//#######################################################################
+// Called after each transfer to a board with the result of that
+// transfer.  A run of failures takes the board out of service so
+// Update drops its writes without touching the bus.
+//#######################################################################
+void I2C_INTERFACE_C::Health (I2C_BOARD_T& brd, uint8_t err)
+    {
+    if ( err == 0 )
+        {
+        brd.Failures   = 0;
+        brd.ProbeDelay = I2C_PROBE_MIN;     // backoff restarts once the board is carrying traffic
+        return;
+        }
+    if ( ++brd.Failures >= I2C_QUARANTINE_FAILS && brd.Valid )
+        {
+        ERROR ("Quarantine of cluster %d  slice %d  port %#02.2X  \"%s\"", brd.Board.Cluster, brd.Board.Slice, brd.Board.Port, brd.Board.Name);
+        Quarantine (brd);
+        }
+    }
 
-    if ( _BoardCount == 0 )
-        return (-1);
+//#######################################################################
+void I2C_INTERFACE_C::Quarantine (I2C_BOARD_T& brd)
+    {
+    brd.Valid       = false;
+    brd.Recover     = false;
+    brd.NewDataMask = 0;
+    brd.ProbeTime   = millis () + brd.ProbeDelay;
+    brd.Count.Quarantines++;
+    }
 
-    Wire.begin ();
-    Wire.setClock (clock);
-//    Wire.setClock (3400000UL);       // clock for 3.4Mhz
-//    Wire.setClock (1700000UL);       // clock for 1.7Mhz
-//    Wire.setClock (800000UL);       // clock for High-speed to Ultra-fast mode
-//    Wire.setClock (400000UL);     // clock for Fast mode
+//#######################################################################
+// Background recovery.  At most one bus action per call so the loop
+// never carries more than a single probe or a single board Init.
+// The backoff doubles with each unanswered probe up to I2C_PROBE_MAX.
+//#######################################################################
+void I2C_INTERFACE_C::Reprobe ()
+    {
+    uint32_t now = millis ();
 
-    for ( int z = 0;  z < _BoardCount;  z++ )      // first, let's check the cluster expanders
+    for ( int z = 0;  z < _BoardCount;  z++ )
         {
-        I2C_LOCATION_T& board = _pBoard[z].Board;
+        I2C_BOARD_T& brd = _pBoard[z];
 
-        if ( board.Cluster != -1 )
+        if ( brd.Recover )
             {
-            Wire.beginTransmission (0x70 + board.Cluster);  // TCA9548A address
-            Wire.write (0);                                 // send byte to select bus
-            _LastEndT = Wire.endTransmission();
-            if ( _LastEndT )
-                DBGMUX ("Return for cluster %d is %s", board.Cluster, ErrorStringI2C (_LastEndT));
-            if ( _LastEndT > err )
-                err = _LastEndT;
+            brd.Recover  = false;
+            brd.Failures = 0;
+            brd.Valid    = true;
+            InitBoard (brd);
+            // replay the shadow values on the next Update
+            brd.NewDataMask = (uint16_t)((1UL << (brd.Board.NumberDtoA + brd.Board.NumberDigital)) - 1);
+            brd.Count.Recoveries++;
+            DBGERROR ("Recovered cluster %d  slice %d  port %#02.2X  \"%s\"", brd.Board.Cluster, brd.Board.Slice, brd.Board.Port, brd.Board.Name);
+            return;
             }
         }
-    if ( err > 0 )
-        {
-        printf ("\n  ### Cluster access error \"%s\".\n", ErrorStringI2C (err));
-        return (-1);
-        }
 
-    int  ecount = 0;
     for ( int z = 0;  z < _BoardCount;  z++ )
         {
-        I2C_LOCATION_T& board = _pBoard[z].Board;
-        if ( _DebugI2C )
-            printf("\t  >> Init: Cluster %d  Slice %d  Port 0x%X  %s    ", board.Cluster, board.Slice, board.Port,  board.Name);
+        I2C_BOARD_T& brd = _pBoard[z];
+
+        if ( brd.Valid || (int32_t)(now - brd.ProbeTime) < 0 )
+            continue;
         if ( ValidateDevice (z) )
             {
-            printf ("\t****\tFailure to access I2C cluster %d  Slice %d  port %X  \"%s\"\n",  board.Cluster, board.Slice, board.Port, board.Name);
-            ecount++;
+            brd.ProbeDelay = ( brd.ProbeDelay >= I2C_PROBE_MAX / 2 ) ? I2C_PROBE_MAX : brd.ProbeDelay * 2;
+            brd.ProbeTime  = now + brd.ProbeDelay;
             }
         else
             {
-            switch ( _pBoard[z].BoardType )
-                {
-                case MCP47FXBX8:
-                    Init47FXBX8 (board);
-                    break;
-                case MCP4728:
-                    Init4728 (board);
-                    break;
-                case ADS1115:
-                    Init1115 (board);
-                    break;
-                case PCF8575:
-                    Init857x (board);
-                    break;
-                case MCP23008:
-                    Init23008 (board);
-                    break;
-                default:
-                    break;
-                }
+            brd.Valid   = false;            // held out of service until Init is replayed
+            brd.Recover = true;
             }
-        if ( _DebugI2C )
-            printf ("Complete.\n");
+        return;
         }
-    return (ecount);
     }
 
 //#######################################################################
-bool I2C_INTERFACE_C::IsPortValid (short device)
-    {
-    if ( device < _DeviceCount && _pDevice[device].pBoard->Valid )
-        return (true);
-    return (false);
-    }
-
 //#######################################################################
-bool I2C_INTERFACE_C::IsAnalogIn (short device)
+// return:  0 = all good
+//         -1 = Total failure
+//         +X = Some interface errors
+int I2C_INTERFACE_C::Begin (I2C_LOCATION_T* p_location, uint64_t clock)
     {
-    I2C_DEVICE_T& dev = _pDevice[device];
-    if ( dev.pBoard->Valid && (dev.pAtoD != nullptr) )
-        return true;
-    return false;
-    }
+    uint32_t zt = micros ();
 
-//#######################################################################
-bool I2C_INTERFACE_C::IsAnalogOut (short device)
-    {
-    I2C_DEVICE_T& dev = _pDevice[device];
-    if ( dev.pBoard->Valid && (dev.pDtoA != nullptr) )
-        return true;
-    return false;
+    memset (&_Startup, 0, sizeof (_Startup));
+    BuildTables (p_location);
+    _Startup.Tables = micros () - zt;
+    return (Start (clock));
     }
 
 //#######################################################################
-bool I2C_INTERFACE_C::IsDigitalOut (short device)
-    {
-    I2C_DEVICE_T& dev = _pDevice[device];
-    if ( dev.pBoard->Valid && (dev.pDigital != nullptr) )
-        return true;
-    return false;
-    }
-
+// Same as Begin from a binary board map of size bytes
 //#######################################################################
-void I2C_INTERFACE_C::D2Analog (short device, ushort value)
+int I2C_INTERFACE_C::BeginMap (const uint8_t* pmap, size_t size, uint64_t clock)
     {
-    I2C_DEVICE_T& dev = _pDevice[device];
-    I2C_BOARD_T*  brd = dev.pBoard;
-    if ( brd->Valid )
+    uint32_t zt = micros ();
+
+    memset (&_Startup, 0, sizeof (_Startup));
+    if ( !CheckMap (pmap, size) )
+        return (-1);
+    if ( !BuildTablesMap (pmap) )
         {
-        *(dev.pDtoA) = value;
-        bitSet (brd->NewDataMask, dev.DevIndex);      // Bit for this channel is set to identify update required
+        Release ();
+        return (-1);
         }
+    _Startup.Tables = micros () - zt;
+    return (Start (clock));
     }
 
 //#######################################################################
-void I2C_INTERFACE_C::DigitalOut (short device, bool value)
+// Swap to a new board map without a restart.  The new map is checked
+// in full first and a bad one leaves the old tables running.  Slewing
+// channels and pending gate edges point at the old devices so both are
+// dropped before the tables are freed.  Anything holding device numbers,
+// calibration, slew, pitch and gates, has to be set up again after.
+//#######################################################################
+int I2C_INTERFACE_C::Reconfigure (const uint8_t* pmap, size_t size, uint64_t clock)
     {
-    I2C_DEVICE_T& dev = _pDevice[device];
-    I2C_BOARD_T*  brd = dev.pBoard;
+    int ret;
 
-    if ( brd->Valid )
-        {
-        bitWrite(*(dev.pDigital), dev.DevIndex, value);
-        bitSet (brd->NewDataMask, dev.DevIndex);      // Bit for this channel is set to identify update required
-        }
+    if ( !CheckMap (pmap, size) )
+        return (-1);
+    Lock ();
+    SlewLimiter.Reset ();
+    GateEngine.CancelAll ();
+    Release ();
+    ret = BeginMap (pmap, size, clock);
+    Unlock ();
+    return (ret);
     }
 
 //#######################################################################
-void I2C_INTERFACE_C::Update ()
+// Everything Begin does once the tables are built
+//#######################################################################
+int I2C_INTERFACE_C::Start (uint64_t clock)
     {
-    for ( int z = 0;  z < _BoardCount;  z++ )
-        {
-        I2C_BOARD_T& brd = _pBoard[z];
-        if ( brd.NewDataMask != 0 )
-            {
-            I2C_LOCATION_T &board = brd.Board;
-            switch ( brd.BoardType )
+    uint32_t zt = micros ();
+    int      ecount;
+
+    if ( !StartWire (clock) )
+        return (-1);
+//    Wire.setClock (3400000UL);       // clock for 3.4Mhz
+//    Wire.setClock (1700000UL);       // clock for 1.7Mhz
+//    Wire.setClock (800000UL);       // clock for High-speed to Ultra-fast mode
+//    Wire.setClock (400000UL);     // clock for Fast mode
+
+    ecount = ( _FastStart ) ? ProbeAll () : ProbeSerial ();
+    if ( ecount < 0 )
+        return (-1);
+    _StartNext = _BoardCount;
+    StartBusTasks ();
+
+    for ( int z = 0;  z < I2C_BUS_COUNT;  z++ )
+        _Startup.Selects += _Bus[z].MuxCount.Transactions;
+    _Startup.Found   = _BoardCount - ecount;
+    _Startup.Missing = ecount;
+    _Startup.Fast    = _FastStart;
+    _Startup.Total   = _Startup.Tables + (micros () - zt);
+    return (ecount);
+    }
+
+//#######################################################################
+// Controllers up and board clocks chosen.  False with no boards.
+//#######################################################################
+bool I2C_INTERFACE_C::StartWire (uint64_t clock)
+    {
+    uint32_t zt = micros ();
+
+    if ( _BoardCount == 0 )
+        return (false);
+    for ( int z = 0;  z < I2C_BUS_COUNT;  z++ )
+        _Startup.Selects -= _Bus[z].MuxCount.Transactions;    // the difference is taken at the end
+    if ( _Lock == nullptr )
+        _Lock = xSemaphoreCreateMutex ();
+
+    for ( int z = 0;  z < I2C_BUS_COUNT;  z++ )
+        {
+        I2C_BUS_T& bus = _Bus[z];
+
+        if ( bus.BoardCount == 0 )
+            continue;
+        if ( bus.Sda < 0 )
+            bus.pWire->begin ();
+        else
+            bus.pWire->begin (bus.Sda, bus.Scl);
+        bus.pWire->setClock (clock);
+        bus.Clock   = clock;
+        bus.Current = clock;
+        }
+    BuildSpeedClasses ();
+    _Startup.Wire = micros () - zt;
+    return (true);
+    }
+
+//#######################################################################
+// Boards that drive anything.  All input expanders and A/D wait for the
+// background part of a staged start.
+//#######################################################################
+static bool HasOutputs (I2C_LOCATION_T& loc)
+    {
+    return ( loc.NumberDtoA > 0 || (loc.NumberDigital > 0 && loc.InputMask != (uint16_t)((1UL << loc.NumberDigital) - 1)) );
+    }
+
+//#######################################################################
+// Staged start.  Only output boards are touched, gate boards first, each
+// running its Init which leaves gates off and every D/A at zero.  There
+// is no probe and a mux slice is selected once for all its boards.  A
+// mux can come out of a processor reset with a slice still selected so
+// every mux is turned off first.  For safe values other than zero follow
+// with D2Analog and Update.  Loop then validates every board and brings
+// up the A/D and input boards one per call, and reports the reset
+// reason once they are all done.
+//#######################################################################
+int I2C_INTERFACE_C::BeginOutputs (I2C_LOCATION_T* plocation, uint64_t clock)
+    {
+    uint32_t zt = micros ();
+    uint8_t  checked[I2C_BUS_COUNT] = {};               // bit per mux cluster
+
+    memset (&_Startup, 0, sizeof (_Startup));
+    BuildTables (plocation);
+    _Startup.Tables = micros () - zt;
+    if ( !StartWire (clock) )
+        return (-1);
+
+    for ( int z = 0;  z < _BoardCount;  z++ )
+        {
+        I2C_LOCATION_T& loc = _pBoard[z].Board;
+        I2C_BUS_T&      bus = _Bus[loc.Bus];
+
+        if ( loc.Cluster < 0 || bitRead (checked[loc.Bus], loc.Cluster) )
+            continue;
+        bitSet (checked[loc.Bus], loc.Cluster);
+        uint32_t zm = micros ();
+        SetBusClock (bus, I2C_MUX_CLOCK);
+        bus.pWire->beginTransmission (0x70 + loc.Cluster);    // TCA9548A address
+        bus.pWire->write (0);                                 // all slices off
+        EndTransmit (bus, bus.MuxCount, 1);
+        if ( bus.LastEndT )
+            DBGMUX ("Return for cluster %d is %s", loc.Cluster, ErrorStringI2C (bus.LastEndT));
+        _Startup.Mux[loc.Bus] += micros () - zm;
+        }
+
+    for ( int z = 0;  z < _BoardCount;  z++ )
+        _pBoard[z].InScan = false;                      // marks the boards already written
+    for ( int p = (int)I2C_PRIORITY::GATE;  p < (int)I2C_PRIORITY::COUNT;  p++ )
+        {
+        for ( int z = 0;  z < _BoardCount;  z++ )
+            {
+            I2C_BOARD_T&    lead = _pBoard[z];
+            I2C_LOCATION_T& loc  = lead.Board;
+            I2C_BUS_T&      bus  = _Bus[loc.Bus];
+
+            if ( lead.InScan || (int)lead.Priority != p || !HasOutputs (loc) )
+                continue;
+
+            uint32_t zi = micros ();
+            BusMux (loc);
+            bus.Held = loc.Cluster;
+            for ( int k = z;  k < _BoardCount;  k++ )
                 {
-                case MCP47FXBX8:
-                    Write47FXBX8 (brd);
-                    break;
-                case MCP4728:
-                    Write4728 (brd);
-                    break;
-                case PCF8575:
-                    Write857x (brd);
-                    break;
-                case MCP23008:
-                    Write23008 (brd);
-                    break;
-                case ADS1115:
-                default:
-                    break;
+                I2C_BOARD_T& b = _pBoard[k];
+
+                if ( b.InScan || (int)b.Priority != p || !HasOutputs (b.Board) || b.Board.Bus != loc.Bus
+                  || b.Board.Cluster != loc.Cluster || (loc.Cluster >= 0 && b.Board.Slice != loc.Slice) )
+                    continue;
+                b.InScan = true;
+                b.Valid  = true;                        // held to account by Health until validated
+                SetBusClock (bus, b.Clock);
+                (this->*b.pDriver->Init) (b);
+                }
+            bus.Held = -1;
+            EndBusMux (loc);
+            _Startup.Init[loc.Bus] += micros () - zi;
+            }
+        }
+    for ( int z = 0;  z < _BoardCount;  z++ )
+        _pBoard[z].InScan = false;
+
+    for ( int z = 0;  z < I2C_BUS_COUNT;  z++ )
+        _Startup.Selects += _Bus[z].MuxCount.Transactions;
+    _Startup.FirstOutput = micros ();
+    _Startup.Staged      = true;
+    _StartNext           = 0;
+    StartBusTasks ();
+    _Startup.Total = _Startup.Tables + (micros () - zt);
+    return (0);
+    }
+
+//#######################################################################
+// Background part of a staged start, one board per Loop.
+//#######################################################################
+void I2C_INTERFACE_C::StartStep ()
+    {
+    I2C_BOARD_T& brd   = _pBoard[_StartNext];
+    bool         early = brd.Valid;                     // written by BeginOutputs
+    uint32_t     zt    = micros ();
+
+    if ( ValidateDevice (_StartNext) )
+        {
+        printf ("\t****\tFailure to access I2C cluster %d  Slice %d  port %X  \"%s\"\n",  brd.Board.Cluster, brd.Board.Slice, brd.Board.Port, brd.Board.Name);
+        Quarantine (brd);
+        _Startup.Missing++;
+        _Startup.Probe[brd.Board.Bus] += micros () - zt;
+        }
+    else
+        {
+        uint32_t zi = micros ();
+
+        _Startup.Found++;
+        _Startup.Probe[brd.Board.Bus] += zi - zt;
+        if ( early )
+            PrimeInputs (brd);
+        else
+            InitBoard (brd);
+        _Startup.Init[brd.Board.Bus] += micros () - zi;
+        }
+    if ( ++_StartNext == _BoardCount )
+        {
+        _Startup.Ready = micros ();
+        if ( _AtoD_queued >= 0 )
+            BeginAtoD (_AtoD_queued);
+        _AtoD_queued = -1;
+        BootDebug (false);
+        }
+    }
+
+//#######################################################################
+// Board by board start.  Every mux is checked, then each board is
+// pinged and set up with its own mux selects.  Returns the boards
+// missing or -1 when a mux does not answer.
+//#######################################################################
+int I2C_INTERFACE_C::ProbeSerial ()
+    {
+    uint8_t err    = 0;
+    int     ecount = 0;
+
+    for ( int z = 0;  z < _BoardCount;  z++ )      // first, let's check the cluster expanders
+        {
+        I2C_LOCATION_T& board = _pBoard[z].Board;
+        I2C_BUS_T&      bus   = _Bus[board.Bus];
+
+        if ( board.Cluster != -1 )
+            {
+            uint32_t zm = micros ();
+
+            bus.pWire->beginTransmission (0x70 + board.Cluster);  // TCA9548A address
+            bus.pWire->write (0);                           // send byte to select bus
+            EndTransmit (bus, bus.MuxCount, 1);
+            if ( bus.LastEndT )
+                DBGMUX ("Return for cluster %d is %s", board.Cluster, ErrorStringI2C (bus.LastEndT));
+            if ( bus.LastEndT > err )
+                err = bus.LastEndT;
+            _Startup.Mux[board.Bus] += micros () - zm;
+            }
+        }
+    if ( err > 0 )
+        {
+        printf ("\n  ### Cluster access error \"%s\".\n", ErrorStringI2C (err));
+        return (-1);
+        }
+
+    for ( int z = 0;  z < _BoardCount;  z++ )
+        {
+        I2C_LOCATION_T& board = _pBoard[z].Board;
+        uint32_t        zp    = micros ();
+        if ( _DebugI2C )
+            printf("\t  >> Init: Cluster %d  Slice %d  Port 0x%X  %s  (%s)    ", board.Cluster, board.Slice, board.Port,  board.Name, _pBoard[z].pDriver->Name);
+        if ( ValidateDevice (z) )
+            {
+            printf ("\t****\tFailure to access I2C cluster %d  Slice %d  port %X  \"%s\"\n",  board.Cluster, board.Slice, board.Port, board.Name);
+            Quarantine (_pBoard[z]);
+            ecount++;
+            _Startup.Probe[board.Bus] += micros () - zp;
+            }
+        else
+            {
+            uint32_t zi = micros ();
+            _Startup.Probe[board.Bus] += zi - zp;
+            InitBoard (_pBoard[z]);
+            _Startup.Init[board.Bus] += micros () - zi;
+            }
+        if ( _DebugI2C )
+            printf ("Complete.\n");
+        }
+    return (ecount);
+    }
+
+//#######################################################################
+// Fast start.  Each bus is probed by its own task when there is more
+// than one so the buses come up together.  Returns the boards missing
+// or -1 when a mux does not answer.
+//#######################################################################
+int I2C_INTERFACE_C::ProbeAll ()
+    {
+    int     started = 0;
+    int     ecount  = 0;
+    uint8_t err     = 0;
+
+    StartBusTasks ();
+    _pCaller = xTaskGetCurrentTaskHandle ();
+    for ( int z = 0;  z < I2C_BUS_COUNT;  z++ )
+        {
+        I2C_BUS_T& bus = _Bus[z];
+
+        if ( bus.BoardCount == 0 )
+            continue;
+        if ( _Parallel && bus.Task != nullptr )
+            {
+            bus.Probing = true;
+            xTaskNotifyGive (bus.Task);
+            started++;
+            }
+        else
+            ProbeBus (bus);
+        }
+    while ( started-- > 0 )
+        ulTaskNotifyTake (pdFALSE, portMAX_DELAY);
+
+    for ( int z = 0;  z < I2C_BUS_COUNT;  z++ )
+        {
+        _Bus[z].Probing = false;
+        if ( _Bus[z].ProbeErr > err )
+            err = _Bus[z].ProbeErr;
+        }
+    if ( err > 0 )
+        {
+        printf ("\n  ### Cluster access error \"%s\".\n", ErrorStringI2C (err));
+        return (-1);
+        }
+    for ( int z = 0;  z < _BoardCount;  z++ )
+        if ( !_pBoard[z].Valid )
+            ecount++;
+    return (ecount);
+    }
+
+//#######################################################################
+// Fast start of one bus.  Each mux is checked once.  Each slice is then
+// selected once while every board expected behind it is pinged, and
+// held while the boards that answered run their Init, so a slice costs
+// one select and one deselect however many boards it has.
+//#######################################################################
+void I2C_INTERFACE_C::ProbeBus (I2C_BUS_T& bus)
+    {
+    uint32_t zt      = micros ();
+    uint8_t  checked = 0;                               // bit per mux cluster
+
+    bus.ProbeErr = 0;
+    for ( int z = 0;  z < _BoardCount;  z++ )
+        {
+        I2C_LOCATION_T& loc = _pBoard[z].Board;
+
+        if ( loc.Bus != bus.Index || loc.Cluster < 0 || bitRead (checked, loc.Cluster) )
+            continue;
+        bitSet (checked, loc.Cluster);
+        bus.pWire->beginTransmission (0x70 + loc.Cluster);    // TCA9548A address
+        bus.pWire->write (0);                                 // all slices off
+        EndTransmit (bus, bus.MuxCount, 1);
+        if ( bus.LastEndT )
+            DBGMUX ("Return for cluster %d is %s", loc.Cluster, ErrorStringI2C (bus.LastEndT));
+        if ( bus.LastEndT > bus.ProbeErr )
+            bus.ProbeErr = bus.LastEndT;
+        }
+    _Startup.Mux[bus.Index] = micros () - zt;
+    if ( bus.ProbeErr )
+        return;
+
+    for ( int z = 0;  z < _BoardCount;  z++ )
+        if ( _pBoard[z].Board.Bus == bus.Index )
+            _pBoard[z].InScan = false;                  // marks the boards already handled
+    for ( int z = 0;  z < _BoardCount;  z++ )
+        {
+        I2C_BOARD_T&    lead = _pBoard[z];
+        I2C_LOCATION_T& loc  = lead.Board;
+
+        if ( loc.Bus != bus.Index || lead.InScan )
+            continue;
+
+        uint32_t zp = micros ();
+        BusMux (loc);
+        bus.Held = loc.Cluster;
+        for ( int k = z;  k < _BoardCount;  k++ )
+            {
+            I2C_BOARD_T& b = _pBoard[k];
+
+            if ( b.InScan || b.Board.Bus != loc.Bus || b.Board.Cluster != loc.Cluster || (loc.Cluster >= 0 && b.Board.Slice != loc.Slice) )
+                continue;
+            b.InScan = true;
+            SetBusClock (bus, b.Clock);
+            bus.pWire->beginTransmission (b.Board.Port);
+            EndTransmit (bus, b.Count, 0);
+            b.Valid = ( bus.LastEndT == 0 );
+            }
+
+        uint32_t zi = micros ();
+        _Startup.Probe[bus.Index] += zi - zp;
+        for ( int k = z;  k < _BoardCount;  k++ )
+            {
+            I2C_BOARD_T& b = _pBoard[k];
+
+            if ( b.Valid && b.Board.Bus == loc.Bus && b.Board.Cluster == loc.Cluster && (loc.Cluster < 0 || b.Board.Slice == loc.Slice) )
+                InitBoard (b);
+            }
+        bus.Held = -1;
+        EndBusMux (loc);
+        _Startup.Init[bus.Index] += micros () - zi;
+        }
+
+    for ( int z = 0;  z < _BoardCount;  z++ )
+        {
+        I2C_BOARD_T& brd = _pBoard[z];
+
+        if ( brd.Board.Bus != bus.Index )
+            continue;
+        brd.InScan = false;
+        if ( !brd.Valid )
+            {
+            printf ("\t****\tFailure to access I2C cluster %d  Slice %d  port %X  \"%s\"\n",  brd.Board.Cluster, brd.Board.Slice, brd.Board.Port, brd.Board.Name);
+            Quarantine (brd);
+            }
+        }
+    }
+
+//#######################################################################
+// Everything in the map has to sit inside the size bytes it was given,
+// every name included, and every record has to add up, so a bad
+// partition is refused before any table is touched.
+//#######################################################################
+bool I2C_INTERFACE_C::CheckMap (const uint8_t* pmap, size_t size)
+    {
+    const I2C_MAP_HEADER_T* phdr = (const I2C_MAP_HEADER_T*)pmap;
+
+    if ( pmap == nullptr || size < sizeof (I2C_MAP_HEADER_T) || phdr->Magic != I2C_MAP_MAGIC )
+        {
+        ERROR ("Not a board map");
+        return (false);
+        }
+    if ( phdr->Version != I2C_MAP_VERSION )
+        {
+        ERROR ("Board map version %d not supported", phdr->Version);
+        return (false);
+        }
+
+    size_t names = sizeof (I2C_MAP_HEADER_T) + (phdr->BoardCount * sizeof (I2C_MAP_BOARD_T));
+    if ( phdr->BoardCount == 0 || phdr->Size > size || names > phdr->Size )
+        {
+        ERROR ("Board map is truncated");
+        return (false);
+        }
+
+    const I2C_MAP_BOARD_T* prec    = (const I2C_MAP_BOARD_T*)(pmap + sizeof (I2C_MAP_HEADER_T));
+    int                    devices = 0;
+    for ( int z = 0;  z < phdr->BoardCount;  z++, prec++ )
+        {
+        if ( prec->FirstDevice != devices )
+            {
+            ERROR ("Board map record %d starts at device %d, not %d", z, prec->FirstDevice, devices);
+            return (false);
+            }
+        devices += prec->NumberDtoA + prec->NumberAtoD + prec->NumberDigital;
+        if ( prec->Cluster < -1 || prec->Cluster >= I2C_MUX_MAX || prec->Slice < -1 || prec->Slice >= I2C_MUX_MAX
+          || (prec->Cluster < 0) != (prec->Slice < 0)
+          || prec->NameOffset < names || prec->NameOffset >= phdr->Size
+          || memchr (pmap + prec->NameOffset, 0, phdr->Size - prec->NameOffset) == nullptr
+          || prec->NumberDtoA > MAX_ANALOG_PER_BOARD || prec->NumberAtoD > (MAX_ANALOG_PER_BOARD / 2) || prec->NumberDigital > 16
+          || !DriverFits (prec->Driver, prec->NumberDtoA, prec->NumberAtoD, prec->NumberDigital)
+          || prec->Priority == I2C_PRIORITY::AUTO || prec->Priority >= I2C_PRIORITY::COUNT )
+            {
+            ERROR ("Board map record %d is bad", z);
+            return (false);
+            }
+        }
+    if ( devices != phdr->DeviceCount )
+        {
+        ERROR ("Board map has %d devices on its boards, not %d", devices, phdr->DeviceCount);
+        return (false);
+        }
+    return (true);
+    }
+
+//#######################################################################
+// Build a board map from a location table, resolving everything that
+// Begin would.  With a null buffer only the size is returned.  Returns
+// 0 when the buffer is too small.
+//#######################################################################
+size_t I2C_INTERFACE_C::MakeMap (I2C_LOCATION_T* plocation, uint8_t* pbuf, size_t size)
+    {
+    int    count = 0;
+    size_t needed;
+
+    for ( count = 0;  plocation[count].Port != -1;  count++ );
+    needed = sizeof (I2C_MAP_HEADER_T) + (count * sizeof (I2C_MAP_BOARD_T));
+    for ( int z = 0;  z < count;  z++ )
+        needed += strlen (plocation[z].Name) + 1;
+    if ( pbuf == nullptr )
+        return (needed);
+    if ( size < needed || needed > 0xFFFF )
+        return (0);
+
+    I2C_MAP_HEADER_T* phdr  = (I2C_MAP_HEADER_T*)pbuf;
+    I2C_MAP_BOARD_T*  prec  = (I2C_MAP_BOARD_T*)(pbuf + sizeof (I2C_MAP_HEADER_T));
+    size_t            names = sizeof (I2C_MAP_HEADER_T) + (count * sizeof (I2C_MAP_BOARD_T));
+    int               first = 0;
+
+    memset (pbuf, 0, needed);
+    phdr->Magic      = I2C_MAP_MAGIC;
+    phdr->Version    = I2C_MAP_VERSION;
+    phdr->BoardCount = count;
+    phdr->Size       = needed;
+    for ( int z = 0;  z < count;  z++, prec++ )
+        {
+        I2C_LOCATION_T& loc = plocation[z];
+
+        prec->Cluster       = ( loc.Cluster < 0 ) ? -1 : loc.Cluster;
+        prec->Slice         = ( loc.Cluster < 0 ) ? -1 : loc.Slice;     // no mux, no output select
+        prec->Port          = loc.Port;
+        prec->Bus           = ( loc.Bus < 0 || loc.Bus >= I2C_BUS_COUNT ) ? 0 : loc.Bus;
+        prec->NumberDtoA    = loc.NumberDtoA;
+        prec->NumberAtoD    = loc.NumberAtoD;
+        prec->NumberDigital = loc.NumberDigital;
+        prec->MaxClock      = loc.MaxClock;
+        prec->InputMask     = ( loc.NumberDigital ) ? loc.InputMask : 0;
+        prec->Driver        = ( loc.Driver == I2C_DRIVER::AUTO || loc.Driver >= I2C_DRIVER::COUNT ) ? AutoDriver (loc) : loc.Driver;
+        prec->Priority      = loc.Priority;
+        if ( prec->Priority == I2C_PRIORITY::AUTO || prec->Priority >= I2C_PRIORITY::COUNT )
+            {
+            if ( loc.NumberDigital )
+                prec->Priority = I2C_PRIORITY::GATE;
+            else if ( loc.NumberDtoA )
+                prec->Priority = I2C_PRIORITY::MOD;
+            else
+                prec->Priority = I2C_PRIORITY::ATOD;
+            }
+        prec->FirstDevice = first;
+        first += loc.NumberDtoA + loc.NumberAtoD + loc.NumberDigital;
+        prec->NameOffset = names;
+        strcpy ((char*)pbuf + names, loc.Name);
+        names += strlen (loc.Name) + 1;
+        }
+    phdr->DeviceCount = first;
+    return (needed);
+    }
+
+//#######################################################################
+// Maps a board map in place.  On the ESP32 name is the label of a data
+// partition, on a host build a file.
+//#######################################################################
+bool I2C_INTERFACE_C::OpenMap (const char* name, I2C_MAP_FILE_T& file)
+    {
+    file.pData  = nullptr;
+    file.Size   = 0;
+    file.Handle = 0;
+#ifdef ESP_PLATFORM
+    const esp_partition_t* part = esp_partition_find_first (ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, name);
+    const void*            ptr;
+    I2C_MMAP_HANDLE        handle;
+
+    if ( part == nullptr )
+        {
+        ERROR ("No partition \"%s\"", name);
+        return (false);
+        }
+    if ( esp_partition_mmap (part, 0, part->size, I2C_MMAP_DATA, &ptr, &handle) != ESP_OK )
+        {
+        ERROR ("Unable to map partition \"%s\"", name);
+        return (false);
+        }
+    file.pData  = (const uint8_t*)ptr;
+    file.Size   = part->size;
+    file.Handle = handle;
+#else
+    struct stat st;
+    int         fd = open (name, O_RDONLY);
+
+    if ( fd < 0 )
+        {
+        ERROR ("No board map file \"%s\"", name);
+        return (false);
+        }
+    if ( fstat (fd, &st) == 0 && st.st_size > 0 )
+        {
+        void* pmap = mmap (nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if ( pmap != MAP_FAILED )
+            {
+            file.pData = (const uint8_t*)pmap;
+            file.Size  = st.st_size;
+            }
+        }
+    close (fd);
+#endif
+    if ( file.pData != nullptr && !CheckMap (file.pData, file.Size) )
+        CloseMap (file);
+    return (file.pData != nullptr);
+    }
+
+//#######################################################################
+// Only once the map is no longer loaded, the board names point into it
+//#######################################################################
+void I2C_INTERFACE_C::CloseMap (I2C_MAP_FILE_T& file)
+    {
+    if ( file.pData == nullptr )
+        return;
+#ifdef ESP_PLATFORM
+    I2C_MUNMAP (file.Handle);
+#else
+    munmap ((void*)file.pData, file.Size);
+#endif
+    file.pData = nullptr;
+    file.Size  = 0;
+    }
+
+//#######################################################################
+// One flush task per bus in use.  Nothing is started when there is only
+// a single bus because the caller can drive it directly.
+//#######################################################################
+void I2C_INTERFACE_C::StartBusTasks ()
+    {
+    static const char* name[I2C_BUS_COUNT] = { "I2C bus 0", "I2C bus 1" };
+
+    if ( _BusesUsed < 2 )
+        return;
+    for ( int z = 0;  z < I2C_BUS_COUNT;  z++ )
+        {
+        I2C_BUS_T& bus = _Bus[z];
+
+        if ( bus.BoardCount == 0 || bus.Task != nullptr )
+            continue;
+        if ( xTaskCreatePinnedToCore (BusTask, name[z], I2C_TASK_STACK, &bus, I2C_TASK_PRIORITY, &bus.Task, z & 1) != pdPASS )
+            {
+            ERROR ("Unable to start flush task for bus %d", z);
+            bus.Task = nullptr;
+            }
+        }
+    }
+
+//#######################################################################
+void I2C_INTERFACE_C::BusTask (void* arg)
+    {
+    I2C_BUS_T& bus = *(I2C_BUS_T*)arg;
+
+    for ( ;; )
+        {
+        ulTaskNotifyTake (pdTRUE, portMAX_DELAY);
+        if ( bus.Probing )
+            bus.pOwner->ProbeBus (bus);
+        else
+            bus.pOwner->FlushBus (bus, bus.Pass);
+        xTaskNotifyGive (bus.pOwner->_pCaller);
+        }
+    }
+
+//#######################################################################
+void I2C_INTERFACE_C::SetBusPins (int bus, int sda, int scl)
+    {
+    if ( bus < 0 || bus >= I2C_BUS_COUNT )
+        return;
+    _Bus[bus].Sda = sda;
+    _Bus[bus].Scl = scl;
+    }
+
+//#######################################################################
+void I2C_INTERFACE_C::SetBusClock (I2C_BUS_T& bus, uint32_t clock)
+    {
+    if ( bus.Current == clock )
+        return;
+    bus.pWire->setClock (clock);
+    bus.Current = clock;
+    bus.ClockChanges++;
+    }
+
+//#######################################################################
+// Pick each board's clock and collect the distinct clocks on each bus.
+// A board runs at its own MaxClock unless it sits behind a mux, which
+// caps it at I2C_MUX_CLOCK.  A board can never go slower than the bus
+// base clock given to Begin.
+//#######################################################################
+void I2C_INTERFACE_C::BuildSpeedClasses ()
+    {
+    for ( int z = 0;  z < I2C_BUS_COUNT;  z++ )
+        {
+        _Bus[z].Classes  = 1;
+        _Bus[z].Class[0] = _Bus[z].Clock;
+        }
+    for ( int z = 0;  z < _BoardCount;  z++ )
+        {
+        I2C_BOARD_T&    brd   = _pBoard[z];
+        I2C_BUS_T&      bus   = _Bus[brd.Board.Bus];
+        uint32_t        clock = brd.Board.MaxClock;
+        int             zc;
+
+        if ( brd.Board.Cluster >= 0 && clock > I2C_MUX_CLOCK )
+            clock = I2C_MUX_CLOCK;
+        if ( clock < bus.Clock )
+            clock = bus.Clock;
+        for ( zc = 0;  zc < bus.Classes && bus.Class[zc] < clock;  zc++ );
+        if ( zc == bus.Classes || bus.Class[zc] != clock )
+            {
+            if ( bus.Classes == I2C_SPEED_CLASSES )
+                clock = bus.Class[zc - 1];          // out of classes, use the next slower one
+            else
+                {
+                memmove (&bus.Class[zc + 1], &bus.Class[zc], (bus.Classes - zc) * sizeof (uint32_t));
+                bus.Class[zc] = clock;
+                bus.Classes++;
+                }
+            }
+        brd.Clock = clock;
+        }
+    }
+
+//#######################################################################
+// Limit the estimated wire time each Update spends on a bus.  A/D
+// polling in Loop gets whatever the last Update left.  Zero removes
+// the limit.
+//#######################################################################
+void I2C_INTERFACE_C::SetBudget (int bus, uint32_t usec)
+    {
+    if ( bus < 0 || bus >= I2C_BUS_COUNT )
+        return;
+    _Bus[bus].Budget = usec;
+    }
+
+//#######################################################################
+// Bytes moved by a full refresh of the board, used for bus placement
+//#######################################################################
+static int Traffic (I2C_LOCATION_T& loc)
+    {
+    int bytes = ( loc.Cluster < 0 ) ? 0 : 4;            // mux select and deselect
+    if ( loc.NumberDtoA == 4 )
+        bytes += 9;
+    else if ( loc.NumberDtoA )
+        bytes += 1 + (loc.NumberDtoA * 3);
+    if ( loc.NumberDigital )
+        bytes += 3;
+    if ( loc.NumberAtoD )
+        bytes += 8;
+    return (bytes);
+    }
+
+//#######################################################################
+// Fill in the Bus field of a board table so the expected refresh traffic
+// is balanced.  Boards behind the same mux cluster have to share a bus
+// so they are placed as a group, heaviest group first, each going to the
+// lightest bus.  Run this before Begin and wire the boards to match.
+//#######################################################################
+void I2C_INTERFACE_C::BalanceBuses (I2C_LOCATION_T* plocation, int buses)
+    {
+    int count = 0;
+    int load[I2C_BUS_COUNT] = { 0 };
+
+    if ( buses > I2C_BUS_COUNT )
+        buses = I2C_BUS_COUNT;
+    for ( count = 0;  plocation[count].Port != -1;  count++ )
+        plocation[count].Bus = -1;
+
+    for ( ;; )
+        {
+        int heavy  = -1;
+        int weight = 0;
+
+        for ( int z = 0;  z < count;  z++ )         // find the heaviest group still unplaced
+            {
+            if ( plocation[z].Bus >= 0 )
+                continue;
+            int w = 0;
+            for ( int zz = 0;  zz < count;  zz++ )
+                {
+                if ( zz == z || (plocation[z].Cluster >= 0 && plocation[zz].Cluster == plocation[z].Cluster) )
+                    w += Traffic (plocation[zz]);
+                }
+            if ( heavy < 0 || w > weight )
+                {
+                heavy  = z;
+                weight = w;
+                }
+            }
+        if ( heavy < 0 )
+            break;
+
+        int light = 0;
+        for ( int z = 1;  z < buses;  z++ )
+            if ( load[z] < load[light] )
+                light = z;
+        for ( int z = 0;  z < count;  z++ )
+            {
+            if ( z == heavy || (plocation[heavy].Cluster >= 0 && plocation[z].Cluster == plocation[heavy].Cluster) )
+                plocation[z].Bus = light;
+            }
+        load[light] += weight;
+        if ( _DebugI2C )
+            printf ("\t  >> Bus %d gets \"%s\" group with %d bytes per refresh\n", light, plocation[heavy].Name, weight);
+        }
+    }
+
+//#######################################################################
+// Time a full refresh of every output, first one bus at a time then
+// with the buses flushed in parallel.
+//#######################################################################
+void I2C_INTERFACE_C::BenchmarkFlush (int passes)
+    {
+    static const char* label[4] = { "serial", "parallel", "serial batched", "parallel batched" };
+    bool     parallel = _Parallel;
+    bool     batch    = _Batch;
+    uint32_t elapsed[4];
+    uint32_t calls[4];
+
+    printf ("\n  I2C flush of %d boards on %d buses:\n", _BoardCount, _BusesUsed);
+    for ( int mode = 0;  mode < 4;  mode++ )
+        {
+        _Parallel = ( mode & 1 );
+        _Batch    = ( mode & 2 );
+        calls[mode] = 0;
+        for ( int z = 0;  z < I2C_BUS_COUNT;  z++ )
+            calls[mode] -= _Bus[z].DriverCalls;
+        uint32_t zt = micros ();
+        for ( int pass = 0;  pass < passes;  pass++ )
+            {
+            for ( int z = 0;  z < _BoardCount;  z++ )
+                {
+                I2C_BOARD_T& brd = _pBoard[z];
+                if ( brd.Valid )
+                    brd.NewDataMask = (uint16_t)((1UL << (brd.Board.NumberDtoA + brd.Board.NumberDigital)) - 1);
+                }
+            Update ();
+            }
+        elapsed[mode] = micros () - zt;
+        for ( int z = 0;  z < I2C_BUS_COUNT;  z++ )
+            calls[mode] += _Bus[z].DriverCalls;
+        printf ("    %-18s %8.1f uSec   %5.1f driver calls\n", label[mode], (float)elapsed[mode] / passes, (float)calls[mode] / passes);
+        }
+    _Parallel = parallel;
+    _Batch    = batch;
+    if ( calls[2] < calls[0] )
+        printf ("    batching saves %.1f uSec per driver call\n", ((float)elapsed[0] - elapsed[2]) / (calls[0] - calls[2]));
+    }
+
+//#######################################################################
+// Enable debug output for all I2C modules up to the level compiled in
+//#######################################################################
+void I2C_INTERFACE_C::SetDebug (bool state)
+    {
+    uint8_t level = ( state ) ? DLEVEL_TRACE : DLEVEL_ERROR;
+
+    _DebugI2C = state;
+    DebugSetLevel (DMODULE::I2C,     level);
+    DebugSetLevel (DMODULE::I2C_DA,  level);
+    DebugSetLevel (DMODULE::I2C_AD,  level);
+    DebugSetLevel (DMODULE::I2C_DIG, level);
+    DebugSetLevel (DMODULE::I2C_MUX, level);
+    }
+
+//#######################################################################
+bool I2C_INTERFACE_C::IsPortValid (short device)
+    {
+    if ( device < _DeviceCount && _pDevice[device].pBoard->Valid )
+        return (true);
+    return (false);
+    }
+
+//#######################################################################
+bool I2C_INTERFACE_C::IsAnalogIn (short device)
+    {
+    I2C_DEVICE_T& dev = _pDevice[device];
+    if ( dev.pBoard->Valid && (dev.pAtoD != nullptr) )
+        return true;
+    return false;
+    }
+
+//#######################################################################
+bool I2C_INTERFACE_C::IsAnalogOut (short device)
+    {
+    I2C_DEVICE_T& dev = _pDevice[device];
+    if ( dev.pBoard->Valid && (dev.pDtoA != nullptr) )
+        return true;
+    return false;
+    }
+
+//#######################################################################
+bool I2C_INTERFACE_C::IsDigitalOut (short device)
+    {
+    I2C_DEVICE_T& dev = _pDevice[device];
+    if ( dev.pBoard->Valid && (dev.pDigital != nullptr) && !bitRead (dev.pBoard->Board.InputMask, dev.DevIndex) )
+        return true;
+    return false;
+    }
+
+//#######################################################################
+bool I2C_INTERFACE_C::IsDigitalIn (short device)
+    {
+    I2C_DEVICE_T& dev = _pDevice[device];
+    if ( dev.pBoard->Valid && (dev.pDigital != nullptr) && bitRead (dev.pBoard->Board.InputMask, dev.DevIndex) )
+        return true;
+    return false;
+    }
+
+//#######################################################################
+bool I2C_INTERFACE_C::DigitalIn (short device)
+    {
+    I2C_DEVICE_T& dev = _pDevice[device];
+    return (bitRead (dev.pBoard->InStable, dev.DevIndex));
+    }
+
+//#######################################################################
+// Channels with a slew stage only take the new target here and reach
+// the D/A through the pass in Update ().
+//#######################################################################
+void I2C_INTERFACE_C::D2Analog (short device, ushort value)
+    {
+    I2C_DEVICE_T& dev = _pDevice[device];
+
+    if ( dev.pSlew )
+        SlewLimiter.Target (*dev.pSlew, value);
+    else
+        D2AnalogDirect (device, value);
+    }
+
+//#######################################################################
+void I2C_INTERFACE_C::D2AnalogDirect (short device, ushort value)
+    {
+    I2C_DEVICE_T& dev = _pDevice[device];
+    I2C_BOARD_T*  brd = dev.pBoard;
+
+    if ( dev.pCal )
+        value = dev.pCal->Apply (value);
+    REC_POINT (DTOA, 0, device, (int32_t)value);
+    dev.pDtoA[0] = value >> 8;                      // written big endian straight into the transmit image
+    dev.pDtoA[1] = value & 0xFF;                    // which is kept for replay while quarantined
+    if ( brd->Valid )
+        __atomic_fetch_or (&brd->NewDataMask, (uint16_t)(1 << dev.DevIndex), __ATOMIC_RELEASE);   // channel needs writing
+    }
+
+//#######################################################################
+// The gate task and the loop both set outputs.  Channels share the port
+// byte and the board's update mask so both are changed atomically.
+//#######################################################################
+void I2C_INTERFACE_C::DigitalOut (short device, bool value)
+    {
+    I2C_DEVICE_T& dev = _pDevice[device];
+    I2C_BOARD_T*  brd = dev.pBoard;
+    uint8_t       bit = 1 << (dev.DevIndex & 7);
+
+    if ( bitRead (brd->Board.InputMask, dev.DevIndex) )
+        return;
+    if ( value )
+        __atomic_fetch_or (dev.pDigital, bit, __ATOMIC_RELAXED);
+    else
+        __atomic_fetch_and (dev.pDigital, (uint8_t)~bit, __ATOMIC_RELAXED);
+    if ( brd->Valid )
+        __atomic_fetch_or (&brd->NewDataMask, (uint16_t)(1 << dev.DevIndex), __ATOMIC_RELEASE);   // channel needs writing
+    }
+
+//#######################################################################
+// One priority at a time with the lock released in between, so a gate
+// edge waits for at most one priority's writes rather than the whole
+// Update.  With the flush tasks running the caller hands each bus to
+// its task and waits for all of them to finish the priority.
+//#######################################################################
+void I2C_INTERFACE_C::Update ()
+    {
+    TRACE_SCOPE (I2C_UPDATE, 0);
+
+    Lock ();
+    SlewLimiter.Process ();
+    for ( int z = 0;  z < I2C_BUS_COUNT;  z++ )
+        {
+        _Bus[z].Spent   = 0;
+        _Bus[z].WireEst = 0;
+        }
+    if ( _Offline )                                     // the D/A records are the output
+        {
+        for ( int z = 0;  z < _BoardCount;  z++ )
+            __atomic_store_n (&_pBoard[z].NewDataMask, (uint16_t)0, __ATOMIC_RELAXED);
+        Unlock ();
+        return;
+        }
+    Unlock ();
+
+    for ( int zp = (int)I2C_PRIORITY::GATE;  zp < (int)I2C_PRIORITY::COUNT;  zp++ )    // outputs on an ATOD board go last
+        {
+        I2C_PRIORITY prio = (I2C_PRIORITY)zp;
+
+        Lock ();
+        if ( _Parallel && _BusesUsed > 1 )
+            {
+            int started = 0;
+
+            _pCaller = xTaskGetCurrentTaskHandle ();
+            for ( int z = 0;  z < I2C_BUS_COUNT;  z++ )
+                {
+                I2C_BUS_T& bus = _Bus[z];
+
+                if ( !Pending (bus, prio) )
+                    continue;
+                if ( bus.Task != nullptr )
+                    {
+                    bus.Pass = prio;
+                    xTaskNotifyGive (bus.Task);
+                    started++;
+                    }
+                else
+                    FlushBus (bus, prio);
+                }
+            while ( started-- > 0 )
+                ulTaskNotifyTake (pdFALSE, portMAX_DELAY);
+            }
+        else
+            {
+            for ( int z = 0;  z < I2C_BUS_COUNT;  z++ )
+                if ( Pending (_Bus[z], prio) )
+                    FlushBus (_Bus[z], prio);
+            }
+        Unlock ();
+        }
+    }
+
+//#######################################################################
+// True if a board of the priority on the bus has changes to write
+//#######################################################################
+bool I2C_INTERFACE_C::Pending (I2C_BUS_T& bus, I2C_PRIORITY prio)
+    {
+    if ( bus.BoardCount == 0 )
+        return (false);
+    for ( int z = 0;  z < _BoardCount;  z++ )
+        {
+        I2C_BOARD_T& brd = _pBoard[z];
+        if ( brd.NewDataMask != 0 && brd.Board.Bus == bus.Index && brd.Priority == prio )
+            return (true);
+        }
+    return (false);
+    }
+
+//#######################################################################
+// Write only the changed gate boards, for the gate timer.  The caller
+// holds the lock.
+//#######################################################################
+void I2C_INTERFACE_C::FlushGates ()
+    {
+    for ( int z = 0;  z < I2C_BUS_COUNT;  z++ )
+        {
+        if ( _Bus[z].BoardCount )
+            FlushClass (_Bus[z], I2C_PRIORITY::GATE, 0);
+        }
+    }
+
+//#######################################################################
+// Boards of one priority are written a speed class at a time.  The
+// classes are walked starting from whichever end matches the clock
+// left set so a priority with two speeds only changes clock once.
+//#######################################################################
+void I2C_INTERFACE_C::FlushBus (I2C_BUS_T& bus, I2C_PRIORITY prio)
+    {
+    uint32_t zt    = micros ();
+    uint32_t calls = bus.DriverCalls;
+    uint32_t wire  = bus.WireEst;
+
+    if ( bus.Classes < 2 )
+        FlushClass (bus, prio, 0);
+    else if ( bus.Current == bus.Class[bus.Classes - 1] )
+        {
+        for ( int z = bus.Classes - 1;  z >= 0;  z-- )
+            FlushClass (bus, prio, bus.Class[z]);
+        }
+    else
+        {
+        for ( int z = 0;  z < bus.Classes;  z++ )
+            FlushClass (bus, prio, bus.Class[z]);
+        }
+
+    // Learn the software cost per driver call from what the wire time
+    // estimate does not account for.  It feeds the budget estimates.
+    calls = bus.DriverCalls - calls;
+    zt    = micros () - zt;
+    wire  = bus.WireEst - wire;
+    if ( calls > 0 )
+        {
+        uint32_t over = ( zt > wire ) ? ((zt - wire) << 4) / calls : 0;
+        bus.Overhead  = ((bus.Overhead * 7) + over) >> 3;
+        }
+    }
+
+//#######################################################################
+// Estimated uSec on the wire to flush a board including mux selection
+//#######################################################################
+uint32_t I2C_INTERFACE_C::WireTime (I2C_BOARD_T& brd)
+    {
+    uint32_t bits = (this->*brd.pDriver->Bits) (brd);
+
+    if ( brd.Board.Cluster >= 0 )
+        bits += 2 * (2 + (9 * 2));
+    return ((bits * 1000000UL) / brd.Clock);
+    }
+
+//#######################################################################
+// Start, address, nine per byte and stop for what a flush sends
+//#######################################################################
+uint32_t I2C_INTERFACE_C::BitsImage (I2C_BOARD_T& brd)
+    {
+    uint8_t* ptx;
+
+    return (2 + (9 * (TxSpan (brd, ptx) + 1)));
+    }
+
+//#######################################################################
+// A/D poll:  two register reads
+//#######################################################################
+uint32_t I2C_INTERFACE_C::Bits1115 (I2C_BOARD_T&)
+    {
+    return (98);
+    }
+
+//#######################################################################
+// True if there is bus time left in this Update for the board.  Gates
+// always go out, and so does a board marked first so one larger than
+// the whole budget cannot starve.  Anything else that does not fit
+// stays dirty and is carried forward to the next Update.
+//#######################################################################
+bool I2C_INTERFACE_C::Afford (I2C_BUS_T& bus, I2C_BOARD_T& brd, uint32_t usec, bool first)
+    {
+    return (first || brd.Priority == I2C_PRIORITY::GATE || bus.Budget == 0 || bus.Spent + usec <= bus.Budget);
+    }
+
+//#######################################################################
+// Write the changed boards of one priority on a bus running at a clock,
+// or at any clock when clock is zero.
+//#######################################################################
+void I2C_INTERFACE_C::FlushClass (I2C_BUS_T& bus, I2C_PRIORITY prio, uint32_t clock)
+    {
+    int start    = bus.Next[(int)prio];
+    int deferred = -1;
+
+    // start where the last deferral left off so every board gets its turn
+    for ( int n = 0;  n < _BoardCount;  n++ )
+        {
+        int          z   = (start + n) % _BoardCount;
+        I2C_BOARD_T& brd = _pBoard[z];
+        if ( brd.NewDataMask != 0 && brd.Board.Bus == bus.Index && brd.Priority == prio && (clock == 0 || brd.Clock == clock) )
+            {
+            uint32_t wire = WireTime (brd);
+            uint32_t usec = wire + BoardCalls (brd) * (bus.Overhead >> 4);
+
+            // nothing spent yet or the head of the rotation always goes
+            if ( !Afford (bus, brd, usec, bus.Spent == 0 || n == 0) )
+                {
+                Defer (bus, brd);
+                if ( deferred < 0 )
+                    deferred = z;
+                continue;
+                }
+            SetBusClock (bus, brd.Clock);
+#ifdef I2C_BATCH
+            if ( _Batch && brd.Valid )
+                {
+                I2C_BOARD_T* list[I2C_BATCH_MAX];
+                int          count = 1;
+                uint32_t     bwire = wire;
+                uint32_t     busec = wire + (bus.Overhead >> 4);    // one driver call for the batch
+
+                // gather the rest of the changed boards behind the same mux slice
+                list[0] = &brd;
+                for ( int k = 1;  k < _BoardCount && count < I2C_BATCH_MAX;  k++ )
+                    {
+                    I2C_BOARD_T& b = _pBoard[(z + k) % _BoardCount];
+                    if ( b.NewDataMask != 0 && b.Valid && b.Board.Bus == bus.Index && b.Clock == brd.Clock && b.Priority == prio
+                      && b.Board.Cluster == brd.Board.Cluster && (b.Board.Cluster < 0 || b.Board.Slice == brd.Board.Slice) )
+                        {
+                        uint32_t more = WireTime (b);
+                        if ( Afford (bus, b, busec + more, false) )
+                            {
+                            list[count++] = &b;
+                            bwire += more;
+                            busec += more;
+                            }
+                        }
                     }
-            brd.NewDataMask = 0;
+                if ( count > 1 )
+                    {
+                    if ( FlushSlice (bus, list, count) )
+                        {
+                        for ( int k = 0;  k < count;  k++ )
+                            Written (*list[k]);
+                        bus.Spent   += busec;
+                        bus.WireEst += bwire;
+                        continue;
+                        }
+
+                    // the link failed so the whole slice goes out board by board
+                    for ( int k = 0;  k < count;  k++ )
+                        {
+                        I2C_BOARD_T& b = *list[k];
+                        if ( b.NewDataMask == 0 )           // quarantined by an earlier failure
+                            continue;
+                        uint32_t more = WireTime (b);
+                        WriteBoard (b);
+                        Written (b);
+                        bus.Spent   += more + BoardCalls (b) * (bus.Overhead >> 4);
+                        bus.WireEst += more;
+                        }
+                    continue;
+                    }
+                }
+#endif
+            WriteBoard (brd);
+            Written (brd);
+            bus.Spent   += usec;
+            bus.WireEst += wire;
+            }
+        }
+    if ( deferred >= 0 )
+        bus.Next[(int)prio] = deferred;
+    }
+
+//#######################################################################
+// Driver transactions for a board flushed on its own
+//#######################################################################
+int I2C_INTERFACE_C::BoardCalls (I2C_BOARD_T& brd)
+    {
+    return (( brd.Board.Cluster >= 0 ) ? 3 : 1);
+    }
+
+//#######################################################################
+void I2C_INTERFACE_C::Defer (I2C_BUS_T& bus, I2C_BOARD_T& brd)
+    {
+    bus.Deferred++;
+    brd.Count.Deferrals++;
+    if ( brd.DeferStart == 0 )
+        brd.DeferStart = micros () | 1;     // zero means not deferred
+    }
+
+//#######################################################################
+// Close out any deferral once a board's update finally goes out
+//#######################################################################
+void I2C_INTERFACE_C::Written (I2C_BOARD_T& brd)
+    {
+    if ( brd.DeferStart == 0 )
+        return;
+    uint32_t age = micros () - (brd.DeferStart & ~1UL);
+    if ( age > brd.Count.MaxDeferral )
+        brd.Count.MaxDeferral = age;
+    brd.DeferStart = 0;
+    }
+
+//#######################################################################
+void I2C_INTERFACE_C::WriteBoard (I2C_BOARD_T& brd)
+    {
+    uint16_t sent = __atomic_load_n (&brd.NewDataMask, __ATOMIC_ACQUIRE);
+
+    if ( brd.pDriver->Flush )
+        (this->*brd.pDriver->Flush) (brd);
+    __atomic_fetch_and (&brd.NewDataMask, (uint16_t)~sent, __ATOMIC_RELAXED);     // anything changed during the write goes next time
+    }
+
+#ifdef I2C_BATCH
+static uint8_t batchLink[I2C_BUS_COUNT][I2C_LINK_RECOMMENDED_SIZE (I2C_BATCH_MAX + 2)];
+
+//#######################################################################
+// One command link for the boards behind a mux slice:  mux select, each
+// board's transmit image after a repeated start, mux deselect.  The
+// images stay in place so nothing is copied.  If the link fails the
+// boards are left dirty and FlushClass writes each one on its own,
+// which also pins the failure on the right board.
+//#######################################################################
+bool I2C_INTERFACE_C::FlushSlice (I2C_BUS_T& bus, I2C_BOARD_T** plist, int count)
+    {
+    I2C_LOCATION_T&  loc    = plist[0]->Board;
+    int              normal = 0;                    // driver transactions this would have taken
+    uint8_t*         ptx[I2C_BATCH_MAX];
+    uint8_t          length[I2C_BATCH_MAX];
+    uint16_t         sent[I2C_BATCH_MAX];
+    i2c_cmd_handle_t cmd    = i2c_cmd_link_create_static (batchLink[bus.Index], sizeof (batchLink[bus.Index]));
+
+    if ( cmd == nullptr )
+        return (false);
+    if ( loc.Cluster >= 0 )
+        {
+        i2c_master_start (cmd);
+        i2c_master_write_byte (cmd, ((0x70 + loc.Cluster) << 1) | I2C_MASTER_WRITE, true);
+        i2c_master_write_byte (cmd, 1 << loc.Slice, true);
+        }
+    for ( int z = 0;  z < count;  z++ )
+        {
+        sent[z]   = __atomic_load_n (&plist[z]->NewDataMask, __ATOMIC_ACQUIRE);
+        length[z] = TxSpan (*plist[z], ptx[z]);
+        i2c_master_start (cmd);
+        i2c_master_write_byte (cmd, (plist[z]->Board.Port << 1) | I2C_MASTER_WRITE, true);
+        i2c_master_write (cmd, ptx[z], length[z], true);
+        normal += ( loc.Cluster >= 0 ) ? 3 : 1;
+        }
+    if ( loc.Cluster >= 0 )
+        {
+        i2c_master_start (cmd);
+        i2c_master_write_byte (cmd, ((0x70 + loc.Cluster) << 1) | I2C_MASTER_WRITE, true);
+        i2c_master_write_byte (cmd, 0, true);
+        }
+    i2c_master_stop (cmd);
+
+    esp_err_t err = i2c_master_cmd_begin ((i2c_port_t)bus.Index, cmd, pdMS_TO_TICKS (10));
+    i2c_cmd_link_delete_static (cmd);
+    bus.DriverCalls++;
+
+    if ( err != ESP_OK )
+        {
+        bus.MuxCount.Transactions++;
+        if ( err == ESP_ERR_TIMEOUT )
+            bus.MuxCount.Timeouts++;
+        else
+            bus.MuxCount.OtherErrors++;
+        DBGERROR ("Batch of %d boards at cluster %d slice %d failed: %s", count, loc.Cluster, loc.Slice, esp_err_to_name (err));
+        return (false);
+        }
+
+    if ( loc.Cluster >= 0 )
+        {
+        for ( int z = 0;  z < 2;  z++ )
+            {
+            bus.MuxCount.Transactions++;
+            bus.MuxCount.Bytes    += 1;
+            bus.MuxCount.WireBits += 2 + (9 * 2);
             }
         }
+    bus.LastEndT = 0;
+    for ( int z = 0;  z < count;  z++ )
+        {
+        I2C_BOARD_T& brd = *plist[z];
+
+        brd.Count.Transactions++;
+        brd.Count.Bytes    += length[z];
+        brd.Count.WireBits += 2 + (9 * (length[z] + 1));
+        __atomic_fetch_and (&brd.NewDataMask, (uint16_t)~sent[z], __ATOMIC_RELAXED);
+        Health (brd, 0);
+        }
+    bus.CallsSaved += normal - 1;
+    return (true);
+    }
+#endif
+
+//#######################################################################
+static void AddCounters (I2C_COUNTERS_T& sum, const I2C_COUNTERS_T& add)
+    {
+    sum.Transactions += add.Transactions;
+    sum.Bytes        += add.Bytes;
+    sum.NackAddress  += add.NackAddress;
+    sum.NackData     += add.NackData;
+    sum.Timeouts     += add.Timeouts;
+    sum.OtherErrors  += add.OtherErrors;
+    sum.WireBits     += add.WireBits;
+    sum.Quarantines  += add.Quarantines;
+    sum.Recoveries   += add.Recoveries;
+    sum.Deferrals    += add.Deferrals;
+    if ( add.MaxDeferral > sum.MaxDeferral )
+        sum.MaxDeferral = add.MaxDeferral;
+    }
+
+//#######################################################################
+static uint32_t Failures (const I2C_COUNTERS_T& count)
+    {
+    return (count.NackAddress + count.NackData + count.Timeouts + count.OtherErrors);
+    }
+
+//#######################################################################
+// Global totals are summed here rather than counted on the hot path.
+// Rates cover the time since the previous call.
+//#######################################################################
+void I2C_INTERFACE_C::GetStats (I2C_STATS_T& stats)
+    {
+    memset (&stats, 0, sizeof (stats));
+    uint32_t bits[I2C_BUS_COUNT];
+    float    busy[I2C_BUS_COUNT];           // seconds on the wire
+
+    stats.Time  = millis ();
+    for ( int z = 0;  z < I2C_BUS_COUNT;  z++ )
+        {
+        I2C_BUS_T& bus = _Bus[z];
+
+        stats.Clock[z] = bus.Clock;
+        bits[z]        = bus.MuxCount.WireBits;
+        busy[z]        = ( bus.Clock ) ? (float)bus.MuxCount.WireBits / min (bus.Clock, (uint32_t)I2C_MUX_CLOCK) : 0.0;
+        stats.ClockChanges[z] = bus.ClockChanges - bus.PrevChanges;
+        stats.DriverCalls[z]  = bus.DriverCalls - bus.PrevCalls;
+        stats.CallsSaved[z]   = bus.CallsSaved - bus.PrevSaved;
+        stats.Deferred[z]     = bus.Deferred - bus.PrevDeferred;
+        stats.CallOverhead[z] = bus.Overhead / 16.0;
+        bus.PrevDeferred      = bus.Deferred;
+        bus.PrevChanges       = bus.ClockChanges;
+        bus.PrevCalls         = bus.DriverCalls;
+        bus.PrevSaved         = bus.CallsSaved;
+        AddCounters (stats.Mux, bus.MuxCount);
+        }
+    stats.Total = stats.Mux;
+    for ( int z = 0;  z < _BoardCount;  z++ )
+        {
+        I2C_BOARD_T& brd = _pBoard[z];
+
+        AddCounters (stats.Total, brd.Count);
+        bits[brd.Board.Bus] += brd.Count.WireBits;
+        if ( brd.Clock )
+            busy[brd.Board.Bus] += (float)brd.Count.WireBits / brd.Clock;
+        }
+
+    uint32_t dt    = stats.Time - _PrevTime;
+    uint32_t trans = stats.Total.Transactions - _PrevTotal.Transactions;
+    if ( dt > 0 )
+        stats.BytesPerSecond = (stats.Total.Bytes - _PrevTotal.Bytes) * 1000.0 / dt;
+    for ( int z = 0;  z < I2C_BUS_COUNT;  z++ )
+        {
+        float dbusy = busy[z] - _Bus[z].PrevBusy;
+
+        if ( dt > 0 )
+            stats.BusUtilization[z] = (dbusy * 1000.0) / dt;
+        if ( dbusy > 0 )
+            stats.EffectiveClock[z] = (bits[z] - _Bus[z].PrevBits) / dbusy;
+        if ( stats.BusUtilization[z] > stats.Utilization )
+            stats.Utilization = stats.BusUtilization[z];
+        _Bus[z].PrevBits = bits[z];
+        _Bus[z].PrevBusy = busy[z];
+        }
+    if ( trans > 0 )
+        stats.FailureRate = (float)(Failures (stats.Total) - Failures (_PrevTotal)) / trans;
+    _PrevTotal = stats.Total;
+    _PrevTime  = stats.Time;
+    }
+
+//#######################################################################
+// Plain sum of every counter with none of the rate state GetStats keeps
+//#######################################################################
+void I2C_INTERFACE_C::ErrorTotals (I2C_COUNTERS_T& total)
+    {
+    memset (&total, 0, sizeof (total));
+    for ( int z = 0;  z < I2C_BUS_COUNT;  z++ )
+        AddCounters (total, _Bus[z].MuxCount);
+    for ( int z = 0;  z < _BoardCount;  z++ )
+        AddCounters (total, _pBoard[z].Count);
+    }
+
+//#######################################################################
+bool I2C_INTERFACE_C::BoardStats (int board, I2C_COUNTERS_T& counters)
+    {
+    if ( board < 0 || board >= _BoardCount )
+        return (false);
+    counters = _pBoard[board].Count;
+    return (true);
+    }
+
+//#######################################################################
+void I2C_INTERFACE_C::ResetStats ()
+    {
+    for ( int z = 0;  z < _BoardCount;  z++ )
+        memset (&_pBoard[z].Count, 0, sizeof (I2C_COUNTERS_T));
+    for ( int z = 0;  z < I2C_BUS_COUNT;  z++ )
+        {
+        memset (&_Bus[z].MuxCount, 0, sizeof (I2C_COUNTERS_T));
+        _Bus[z].PrevBits    = 0;
+        _Bus[z].PrevBusy    = 0.0;
+        _Bus[z].PrevChanges = _Bus[z].ClockChanges;
+        _Bus[z].PrevCalls   = _Bus[z].DriverCalls;
+        _Bus[z].PrevSaved   = _Bus[z].CallsSaved;
+        _Bus[z].PrevDeferred = _Bus[z].Deferred;
+        }
+    memset (&_PrevTotal, 0, sizeof (_PrevTotal));
+    _PrevTime = millis ();
+    }
+
+//#######################################################################
+void I2C_INTERFACE_C::DumpStartup ()
+    {
+    printf ("\n  I2C start (%s):  %.2f mSec   tables %.2f   controllers %.2f   %d boards found   %d missing   %u mux writes\n",
+            ( _Startup.Staged ) ? "staged" : (( _Startup.Fast ) ? "fast" : "serial"), _Startup.Total * 0.001, _Startup.Tables * 0.001, _Startup.Wire * 0.001,
+            _Startup.Found, _Startup.Missing, _Startup.Selects);
+    if ( _Startup.Staged )
+        printf ("    first output %.2f mSec after power on   all boards ready %.2f mSec\n",
+                _Startup.FirstOutput * 0.001, _Startup.Ready * 0.001);
+    for ( int z = 0;  z < I2C_BUS_COUNT;  z++ )
+        {
+        if ( _Bus[z].BoardCount == 0 )
+            continue;
+        printf ("    bus %d:  mux check %.2f mSec   probe %.2f mSec   init %.2f mSec\n",
+                z, _Startup.Mux[z] * 0.001, _Startup.Probe[z] * 0.001, _Startup.Init[z] * 0.001);
+        }
+    }
+
+//#######################################################################
+void I2C_INTERFACE_C::DumpStats ()
+    {
+    I2C_STATS_T stats;
+
+    GetStats (stats);
+    printf ("\n  I2C:  %.0f bytes/sec   %.2f%% failed\n", stats.BytesPerSecond, stats.FailureRate * 100.0);
+    for ( int z = 0;  z < I2C_BUS_COUNT;  z++ )
+        {
+        if ( _Bus[z].BoardCount == 0 )
+            continue;
+        printf ("    bus %d at %d Hz with %d boards:  %.1f%% busy   effective %.0f Hz (x%.2f)   %u clock changes\n",
+                z, stats.Clock[z], _Bus[z].BoardCount, stats.BusUtilization[z] * 100.0,
+                stats.EffectiveClock[z], stats.EffectiveClock[z] / stats.Clock[z], stats.ClockChanges[z]);
+        printf ("          %u driver calls   %u saved by batching   %.1f uSec per call\n", stats.DriverCalls[z], stats.CallsSaved[z], stats.CallOverhead[z]);
+        if ( _Bus[z].Budget )
+            printf ("          budget %u uSec per update   %u deferred\n", _Bus[z].Budget, stats.Deferred[z]);
+        }
+    printf ("    %-16s %-10s %10s %10s %7s %7s %7s %7s %7s %5s %5s %7s %7s\n",
+            "board", "location", "trans", "bytes", "nackA", "nackD", "t/o", "other", "fail%", "quar", "recov", "defer", "maxms");
+    for ( int z = -I2C_BUS_COUNT;  z < _BoardCount;  z++ )
+        {
+        if ( z < 0 && _Bus[z + I2C_BUS_COUNT].BoardCount == 0 )
+            continue;
+
+        I2C_COUNTERS_T& cnt = ( z < 0 ) ? _Bus[z + I2C_BUS_COUNT].MuxCount : _pBoard[z].Count;
+        char            where[16];
+
+        if ( z < 0 )
+            snprintf (where, sizeof (where), "%d:mux", z + I2C_BUS_COUNT);
+        else
+            snprintf (where, sizeof (where), "%d:%d:%d:%02X", _pBoard[z].Board.Bus, _pBoard[z].Board.Cluster, _pBoard[z].Board.Slice, _pBoard[z].Board.Port);
+        printf ("    %-16s %-10s %10u %10u %7u %7u %7u %7u %7.2f %5u %5u %7u %7.2f%s\n",
+                ( z < 0 ) ? "" : _pBoard[z].Board.Name, where, cnt.Transactions, cnt.Bytes,
+                cnt.NackAddress, cnt.NackData, cnt.Timeouts, cnt.OtherErrors,
+                ( cnt.Transactions ) ? (Failures (cnt) * 100.0) / cnt.Transactions : 0.0,
+                cnt.Quarantines, cnt.Recoveries, cnt.Deferrals, cnt.MaxDeferral * 0.001,
+                ( z >= 0 && !_pBoard[z].Valid ) ? "  DOWN" : "");
+        }
     }
 
+//#######################################################################
+// During a staged start the A/D board may not be up yet so the request
+// is held and made once every board has been brought up.
 //#######################################################################
 void I2C_INTERFACE_C::StartAtoD (short device)
+    {
+    Lock ();
+    if ( _StartNext < _BoardCount )
+        _AtoD_queued = device;
+    else
+        BeginAtoD (device);
+    Unlock ();
+    }
+
+//#######################################################################
+// Caller holds the lock
+//#######################################################################
+void I2C_INTERFACE_C::BeginAtoD (short device)
     {
     I2C_DEVICE_T& dev = _pDevice[device];
     I2C_LOCATION_T& loc = dev.pBoard->Board;
 
+    if ( !dev.pBoard->Valid )
+        return;
+    SetBusClock (_Bus[loc.Bus], dev.pBoard->Clock);
     BusMux (loc);
     Start1115 (dev);
+    Health (*dev.pBoard, _Bus[loc.Bus].LastEndT);
     EndBusMux (loc);
     _AtoD_loopDevice = device;
     }
 
+//#######################################################################
+// Back to the power on setup of the A/D board.  The Init leaves the
+// chip idle so the channel the A/D loop was converting is started again.
+//#######################################################################
+void I2C_INTERFACE_C::ResetAnalog (short device)
+    {
+    I2C_BOARD_T& brd = *_pDevice[device].pBoard;
+
+    if ( !brd.Valid )
+        return;
+    Lock ();
+    SetBusClock (_Bus[brd.Board.Bus], brd.Clock);
+    Init1115 (brd);
+    if ( _AtoD_loopDevice > 0 && _pDevice[_AtoD_loopDevice].pBoard == &brd )
+        {
+        BusMux (brd.Board);
+        Start1115 (_pDevice[_AtoD_loopDevice]);         // put back the channel the A/D loop was converting
+        EndBusMux (brd.Board);
+        }
+    Health (brd, _Bus[brd.Board.Bus].LastEndT);
+    Unlock ();
+    }
+
+//#######################################################################
+// Single conversion that waits for the result.  For setup and
+// calibration, never from the loop.
+//#######################################################################
+bool I2C_INTERFACE_C::MeasureAtoD (short device, int16_t& value)
+    {
+    I2C_DEVICE_T& dev = _pDevice[device];
+    I2C_BOARD_T&  brd = *dev.pBoard;
+    bool          ok  = false;
+
+    if ( dev.pAtoD == nullptr || !brd.Valid )
+        return (false);
+    Lock ();
+    SetBusClock (_Bus[brd.Board.Bus], brd.Clock);
+    BusMux (brd.Board);
+    Start1115 (dev);
+    for ( uint32_t start = millis ();  (millis () - start) < I2C_ATOD_TIMEOUT;  delay (1) )
+        {
+        if ( ReadRegister16 (brd, ADS1115_CONFIG_REG_ADDR) & (1 << ADS1115_OS_FLAG_POS) )
+            {
+            value = ReadRegister16 (brd, ADS1115_CONVERSION_REG_ADDR);
+            ok    = true;
+            break;
+            }
+        }
+    if ( _AtoD_loopDevice > 0 && _pDevice[_AtoD_loopDevice].pBoard == &brd )
+        Start1115 (_pDevice[_AtoD_loopDevice]);         // put back the channel the A/D loop was converting
+    EndBusMux (brd.Board);
+    Unlock ();
+    return (ok);
+    }
+
+//#######################################################################
+// Write the board holding a device now whatever the bus budget.  For
+// blocking setup work such as calibration, not from the loop.
+//#######################################################################
+void I2C_INTERFACE_C::FlushDevice (short device)
+    {
+    I2C_BOARD_T& brd = *_pDevice[device].pBoard;
+
+    Lock ();
+    if ( brd.NewDataMask != 0 )
+        {
+        SetBusClock (_Bus[brd.Board.Bus], brd.Clock);
+        WriteBoard (brd);
+        Written (brd);
+        }
+    Unlock ();
+    }
+
+//#######################################################################
+void I2C_INTERFACE_C::SetCalibration (short device, const CAL_CHANNEL_S* pcal)
+    {
+    if ( device >= 0 && device < _DeviceCount && _pDevice[device].pDtoA != nullptr )
+        _pDevice[device].pCal = pcal;
+    }
+
+//#######################################################################
+void I2C_INTERFACE_C::SetSlew (short device, SLEW_CHANNEL_S* pslew)
+    {
+    if ( device >= 0 && device < _DeviceCount && _pDevice[device].pDtoA != nullptr )
+        _pDevice[device].pSlew = pslew;
+    }
+
+//#######################################################################
+static volatile bool inputSignal = false;
+
+static void IRAM_ATTR InputInterrupt ()
+    {
+    inputSignal = true;
+    }
+
+//#######################################################################
+// GPIO wired to the expander interrupt outputs.  They are open drain so
+// every input board can share the one line.  Call before Begin so the
+// MCP23008s are set up to drive it.
+//#######################################################################
+void I2C_INTERFACE_C::SetInputInterrupt (int pin)
+    {
+    _IntPin = pin;
+    if ( pin < 0 )
+        return;
+    pinMode (pin, INPUT_PULLUP);
+    attachInterrupt (digitalPinToInterrupt (pin), InputInterrupt, FALLING);
+    }
+
+//#######################################################################
+// Caller has the mux set.  On failure the last good state is returned.
+//#######################################################################
+uint16_t I2C_INTERFACE_C::ReadInputs (I2C_BOARD_T& brd)
+    {
+    if ( brd.pDriver->Read == nullptr )
+        return (brd.InRaw);
+    return ((this->*brd.pDriver->Read) (brd));
+    }
+
+//#######################################################################
+// A PCF857x just answers with its pins.  Reading also clears the
+// interrupt.
+//#######################################################################
+uint16_t I2C_INTERFACE_C::Read857x (I2C_BOARD_T& brd)
+    {
+    I2C_BUS_T& bus   = _Bus[brd.Board.Bus];
+    uint8_t    bytes = (brd.Board.NumberDigital + 7) >> 3;
+    uint16_t   data  = 0;
+    uint8_t    got   = bus.pWire->requestFrom (brd.Board.Port, bytes, true);
+
+    CountRead (brd.Count, got, bytes);
+    bus.LastEndT = ( got < bytes ) ? 4 : 0;             // "other error" so Health counts it
+    Health (brd, bus.LastEndT);
+    if ( bus.LastEndT )
+        return (brd.InRaw);
+    for ( int z = 0;  z < bytes;  z++ )
+        data |= bus.pWire->read () << (z * 8);
+    return (data & brd.Board.InputMask);
+    }
+
+//#######################################################################
+// The MCP23008 needs the GPIO register selected first
+//#######################################################################
+uint16_t I2C_INTERFACE_C::Read23008 (I2C_BOARD_T& brd)
+    {
+    I2C_BUS_T& bus = _Bus[brd.Board.Bus];
+
+    bus.pWire->beginTransmission (brd.Board.Port);
+    bus.pWire->write (0x09);                            // GPIO
+    EndTransmit (bus, brd.Count, 1);
+    if ( bus.LastEndT )
+        {
+        Health (brd, bus.LastEndT);
+        return (brd.InRaw);
+        }
+    return (Read857x (brd));
+    }
+
+//#######################################################################
+// Poll the conversion StartAtoD started.  Once it is done the reading
+// goes into the board's A/D slot and the channel's bit is returned.
+// Caller has the mux set.
+//#######################################################################
+uint16_t I2C_INTERFACE_C::Read1115 (I2C_BOARD_T& brd)
+    {
+    I2C_DEVICE_T& dev = _pDevice[_AtoD_loopDevice];
+
+    if ( dev.pBoard != &brd )
+        return (0);
+    if ( !(ReadRegister16 (brd, ADS1115_CONFIG_REG_ADDR) & (1 << ADS1115_OS_FLAG_POS)) )
+        return (0);
+    *dev.pAtoD = ReadRegister16 (brd, ADS1115_CONVERSION_REG_ADDR);
+    return (1 << dev.DevIndex);
+    }
+
+//#######################################################################
+// A pin has to read the same for I2C_INPUT_DEBOUNCE before the change
+// is taken.  Only changes are reported, from Loop () once the lock is
+// released.  A change that does not fit in the queue stays pending
+// for the next scan.
+//#######################################################################
+void I2C_INTERFACE_C::Debounce (I2C_BOARD_T& brd, uint16_t raw)
+    {
+    uint16_t now     = millis ();
+    uint16_t changed = raw ^ brd.InRaw;
+
+    brd.InRaw     = raw;
+    brd.InPending = raw ^ brd.InStable;
+    for ( int z = 0;  z < brd.Board.NumberDigital;  z++ )
+        {
+        if ( bitRead (changed, z) )
+            brd.InSince[z] = now;
+        if ( bitRead (brd.InPending, z) && (uint16_t)(now - brd.InSince[z]) >= I2C_INPUT_DEBOUNCE && _InEvents < I2C_INPUT_EVENTS )
+            {
+            bool state = bitRead (raw, z);
+
+            bitWrite (brd.InStable, z, state);
+            bitClear (brd.InPending, z);
+            DBGDIG ("%d:%d:%#3.3x input %d = %d  %s", brd.Board.Cluster, brd.Board.Slice, brd.Board.Port, z, state, brd.Board.Name);
+            _InEvent[_InEvents].Device = brd.FirstDevice + z;
+            _InEvent[_InEvents].State  = state;
+            _InEvents++;
+            }
+        }
+    }
+
+//#######################################################################
+// Every input board is read on the interrupt, or each period when there
+// is no interrupt line.  In between only boards still settling are
+// read.  Boards behind the same mux slice share one mux select, and
+// with batching one command link.
+//#######################################################################
+void I2C_INTERFACE_C::ScanInputs ()
+    {
+    uint32_t ms = millis ();
+    bool     all;
+
+    if ( _InputBoards == 0 || _StartNext < _BoardCount )    // nothing until a staged start has primed the inputs
+        return;
+    all = inputSignal;
+    if ( (ms - _InputTime) < _InputPeriod && !all )
+        return;
+    if ( _IntPin < 0 || (ms - _InputFull) >= I2C_INPUT_IDLE )
+        all = true;
+    _InputTime = ms;
+    if ( all )
+        {
+        _InputFull  = ms;
+        inputSignal = false;                            // cleared before the reads so a new edge is not lost
+        }
+
+    for ( int z = 0;  z < _BoardCount;  z++ )
+        _pBoard[z].InScan = false;
+    for ( int z = 0;  z < _BoardCount;  z++ )
+        {
+        I2C_BOARD_T& brd = _pBoard[z];
+
+        if ( brd.InScan || !brd.Valid || !brd.Board.InputMask || !(all || brd.InPending) )
+            continue;
+
+        I2C_LOCATION_T& loc   = brd.Board;
+        I2C_BUS_T&      bus   = _Bus[loc.Bus];
+        I2C_BOARD_T*    list[I2C_BATCH_MAX];
+        uint16_t        raw[I2C_BATCH_MAX];
+        int             count = 0;
+
+        for ( int k = z;  k < _BoardCount && count < I2C_BATCH_MAX;  k++ )
+            {
+            I2C_BOARD_T& b = _pBoard[k];
+
+            if ( b.InScan || !b.Valid || !b.Board.InputMask || !(all || b.InPending) || b.Board.Bus != loc.Bus
+              || b.Board.Cluster != loc.Cluster || (loc.Cluster >= 0 && b.Board.Slice != loc.Slice) )
+                continue;
+            b.InScan      = true;
+            list[count++] = &b;
+            }
+
+        bool read = false;
+#ifdef I2C_BATCH
+        if ( _Batch && count > 1 )
+            read = ReadSlice (bus, list, raw, count);
+#endif
+        if ( !read )
+            {
+            BusMux (loc);
+            for ( int k = 0;  k < count;  k++ )
+                {
+                SetBusClock (bus, list[k]->Clock);
+                raw[k] = ReadInputs (*list[k]);
+                }
+            EndBusMux (loc);
+            }
+        for ( int k = 0;  k < count;  k++ )
+            {
+            I2C_BOARD_T& b    = *list[k];
+            uint32_t     usec = ((22 + 9 * (((b.Board.NumberDigital + 7) >> 3) + 1)) * 1000000UL) / b.Clock;
+
+            Debounce (b, raw[k]);
+            bus.Spent   += usec;
+            bus.WireEst += usec;
+            }
+        }
+    }
+
+#ifdef I2C_BATCH
+//#######################################################################
+// Read the input boards behind a mux slice in one command link:  mux
+// select, each board's read after a repeated start (an MCP23008 first
+// gets its GPIO register address), mux deselect.  The boards have to
+// share a clock.  On failure nothing is taken and the caller reads the
+// boards one at a time, which also pins the failure on the right board.
+//#######################################################################
+bool I2C_INTERFACE_C::ReadSlice (I2C_BUS_T& bus, I2C_BOARD_T** plist, uint16_t* praw, int count)
+    {
+    I2C_LOCATION_T&  loc = plist[0]->Board;
+    uint8_t          rx[I2C_BATCH_MAX][2];
+    uint8_t          bytes[I2C_BATCH_MAX];
+    int              normal = 0;                    // driver transactions this would have taken
+
+    if ( count > I2C_BATCH_MAX / 2 )                // a register read takes two transactions of the link
+        return (false);
+    for ( int z = 1;  z < count;  z++ )
+        {
+        if ( plist[z]->Clock != plist[0]->Clock )
+            return (false);
+        }
+
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create_static (batchLink[bus.Index], sizeof (batchLink[bus.Index]));
+    if ( cmd == nullptr )
+        return (false);
+    SetBusClock (bus, plist[0]->Clock);
+    if ( loc.Cluster >= 0 )
+        {
+        i2c_master_start (cmd);
+        i2c_master_write_byte (cmd, ((0x70 + loc.Cluster) << 1) | I2C_MASTER_WRITE, true);
+        i2c_master_write_byte (cmd, 1 << loc.Slice, true);
+        normal += 2;
+        }
+    for ( int z = 0;  z < count;  z++ )
+        {
+        I2C_BOARD_T& brd = *plist[z];
+
+        bytes[z] = (brd.Board.NumberDigital + 7) >> 3;
+        if ( brd.Board.Driver == I2C_DRIVER::MCP23008 )
+            {
+            i2c_master_start (cmd);
+            i2c_master_write_byte (cmd, (brd.Board.Port << 1) | I2C_MASTER_WRITE, true);
+            i2c_master_write_byte (cmd, 0x09, true);     // GPIO
+            normal++;
+            }
+        i2c_master_start (cmd);
+        i2c_master_write_byte (cmd, (brd.Board.Port << 1) | I2C_MASTER_READ, true);
+        i2c_master_read (cmd, rx[z], bytes[z], I2C_MASTER_LAST_NACK);
+        normal++;
+        }
+    if ( loc.Cluster >= 0 )
+        {
+        i2c_master_start (cmd);
+        i2c_master_write_byte (cmd, ((0x70 + loc.Cluster) << 1) | I2C_MASTER_WRITE, true);
+        i2c_master_write_byte (cmd, 0, true);
+        }
+    i2c_master_stop (cmd);
+
+    esp_err_t err = i2c_master_cmd_begin ((i2c_port_t)bus.Index, cmd, pdMS_TO_TICKS (10));
+    i2c_cmd_link_delete_static (cmd);
+    bus.DriverCalls++;
+    if ( err != ESP_OK )
+        {
+        bus.MuxCount.Transactions++;
+        if ( err == ESP_ERR_TIMEOUT )
+            bus.MuxCount.Timeouts++;
+        else
+            bus.MuxCount.OtherErrors++;
+        DBGERROR ("Input batch of %d boards at cluster %d slice %d failed: %s", count, loc.Cluster, loc.Slice, esp_err_to_name (err));
+        return (false);
+        }
+
+    if ( loc.Cluster >= 0 )
+        {
+        for ( int z = 0;  z < 2;  z++ )
+            {
+            bus.MuxCount.Transactions++;
+            bus.MuxCount.Bytes    += 1;
+            bus.MuxCount.WireBits += 2 + (9 * 2);
+            }
+        }
+    for ( int z = 0;  z < count;  z++ )
+        {
+        I2C_BOARD_T& brd  = *plist[z];
+        uint16_t     data = 0;
+
+        if ( brd.Board.Driver == I2C_DRIVER::MCP23008 )
+            {
+            brd.Count.Transactions++;
+            brd.Count.Bytes    += 1;
+            brd.Count.WireBits += 2 + (9 * 2);
+            }
+        CountRead (brd.Count, bytes[z], bytes[z]);
+        for ( int k = 0;  k < bytes[z];  k++ )
+            data |= rx[z][k] << (k * 8);
+        praw[z] = data & brd.Board.InputMask;
+        Health (brd, 0);
+        }
+    bus.CallsSaved += normal - 1;
+    return (true);
+    }
+#endif
+
 //#######################################################################
 void I2C_INTERFACE_C::Loop ()
     {
     int16_t val;
+    bool    atod = false;
 
-    if ( _AtoD_loopDevice > 0 )
+    Lock ();
+    if ( _StartNext < _BoardCount )
+        StartStep ();
+    else
+        Reprobe ();
+    ScanInputs ();
+    if ( _AtoD_loopDevice > 0 && _pDevice[_AtoD_loopDevice].pBoard->Valid && _pDevice[_AtoD_loopDevice].pBoard->pDriver->Read )
         {
-        I2C_LOCATION_T& loc = _pDevice[_AtoD_loopDevice].pBoard->Board;
-
-        BusMux (loc);
-        val = ReadRegister16 (loc.Port, ADS1115_CONFIG_REG_ADDR);
-        if ( val & (1 << ADS1115_OS_FLAG_POS) )
+        uint32_t        zt  = micros ();
+        I2C_DEVICE_T&   dev = _pDevice[_AtoD_loopDevice];
+        I2C_BOARD_T&    brd = *dev.pBoard;
+        I2C_LOCATION_T& loc = brd.Board;
+        I2C_BUS_T&      bus = _Bus[loc.Bus];
+
+        // two register reads and the mux, taken from what Update left
+        uint32_t usec = WireTime (brd);
+        if ( !Afford (bus, brd, usec, bus.Spent == 0 || brd.DeferStart != 0) )     // a poll deferred once goes next time
+            Defer (bus, brd);
+        else
             {
-            val = ReadRegister16 (loc.Port, ADS1115_CONVERSION_REG_ADDR);
-            _CallbackAtoD (val);
+            Written (brd);
+            bus.Spent   += usec;
+            bus.WireEst += usec;
+            SetBusClock (_Bus[loc.Bus], brd.Clock);
+            BusMux (loc);
+            if ( (this->*brd.pDriver->Read) (brd) & (1 << dev.DevIndex) )
+                {
+                val  = *dev.pAtoD;
+                atod = true;
+                }
+            EndBusMux (loc);
+            ZyTime.PhaseEnd (ZPHASE::ATOD, zt);
             }
-        EndBusMux (loc);
         }
+    Unlock ();
+
+    // callbacks run without the lock so they are free to set outputs
+    for ( int z = 0;  z < _InEvents;  z++ )
+        DeliverDigital (_InEvent[z].Device, _InEvent[z].State);
+    _InEvents = 0;
+    if ( atod )
+        DeliverAtoD (val);
     }
 
 //#######################################################################
@@ -5,14 +5,88 @@
 // Date:       9/4/2023
 //#######################################################################
 #pragma once
+#include "Recorder.h"
 
 #define MAX_ANALOG_PER_BOARD  8
+#define I2C_TX_MAX            (MAX_ANALOG_PER_BOARD * 3)    // largest transmit image, MCP47FXBX8
+
+class TwoWire;
+struct CAL_CHANNEL_S;
+struct SLEW_CHANNEL_S;
 
 //#######################################################################
 #define I2C_SPEED_400   400000UL        // clock for Fast mode
 #define I2C_SPEED_800   800000UL        // clock for High-speed to Ultra-fast mode
 #define I2C_SPEED_1700  1700000UL       // clock for 1.7Mhz
 #define I2C_SPEED_3400  3400000UL       // clock for 3.4Mhz
+#define I2C_MUX_CLOCK   I2C_SPEED_400   // fastest the TCA9548A and anything behind it will run
+#define I2C_SPEED_CLASSES   4           // distinct clocks scheduled on one bus
+
+//#######################################################################
+// Bus controllers.  With boards on more than one bus each bus is
+// flushed by its own task so the transfers run in parallel.
+//#######################################################################
+#define I2C_BUS_COUNT       2           // ESP32 I2C controllers: 0 = Wire, 1 = Wire1
+#define I2C_TASK_PRIORITY   3           // above the Arduino loop task
+#define I2C_TASK_STACK      3072
+#define I2C_CALL_OVERHEAD   60          // starting guess at uSec of software time per driver call
+#define I2C_ATOD_TIMEOUT    20          // mSec to wait on a blocking A/D conversion
+
+//#######################################################################
+// Digital inputs.  Reads go out a mux slice at a time from Loop.  With
+// the expander interrupt line wired the full scan only runs when it
+// fires, plus a slow safety scan in case an edge was missed.
+//#######################################################################
+#define I2C_INPUT_PERIOD    5           // mSec between input scans
+#define I2C_INPUT_DEBOUNCE  10          // mSec a pin must hold before the change is reported
+#define I2C_INPUT_IDLE      250         // mSec between full scans when the interrupt line is used
+#define I2C_INPUT_EVENTS    32          // input changes held for the callback after each scan
+
+//#######################################################################
+// Batched flush.  The changed boards behind each mux slice go out as a
+// single ESP-IDF command link with repeated starts.  Needs the legacy
+// IDF I2C driver that Wire is built on before Arduino core 3.
+//#######################################################################
+#if defined(ESP_ARDUINO_VERSION_MAJOR) && ESP_ARDUINO_VERSION_MAJOR < 3
+#define I2C_BATCH           1           // comment out to always flush board by board
+#endif
+#define I2C_BATCH_MAX       12          // boards in one command link
+
+//#######################################################################
+// Bad board quarantine
+//#######################################################################
+#define I2C_QUARANTINE_FAILS    3       // consecutive failures before a board is dropped
+#define I2C_PROBE_MIN           50      // first re-probe delay in mSec
+#define I2C_PROBE_MAX           10000   // longest re-probe delay in mSec
+
+//#######################################################################
+// Flush order.  Higher priority boards are written first and gates are
+// never held back by the bus time budget.
+//#######################################################################
+enum class I2C_PRIORITY : uint8_t
+    {
+    AUTO = 0,           // digital out is GATE, D/A is MOD and A/D is ATOD
+    GATE,               // gates and triggers
+    PITCH,              // pitch CV
+    MOD,                // modulation CV
+    ATOD,               // A/D polling
+    COUNT
+    };
+
+//#######################################################################
+// Board drivers.  AUTO picks one from the channel counts and address
+// the way boards were always identified.
+//#######################################################################
+enum class I2C_DRIVER : uint8_t
+    {
+    AUTO = 0,
+    MCP4728,            // quad 12 bit digital to analog converter
+    MCP47FXBX8,         // octal 12 bit digital to analog converter
+    ADS1115,            // quad 16 bit analog to digital
+    PCF857X,            // 8 bit (PC8574A) & 16 bit (PCF8575) digital I/O without pullups
+    MCP23008,           // 8 bit digital I/O with pullups
+    COUNT
+    };
 
 //#######################################################################
 typedef struct
@@ -24,91 +98,341 @@ typedef struct
     int         NumberAtoD;
     int         NumberDigital;  // number of digital I/O channeld: 8 / 16
     const char* Name;
+    int         Bus;            // I2C controller, 0 if not specified
+    uint32_t    MaxClock;       // fastest clock the board supports, 0 for the bus clock
+    I2C_PRIORITY Priority;      // flush order, AUTO to pick from the board type
+    uint16_t    InputMask;      // digital channels used as inputs, 0 for all outputs
+    I2C_DRIVER  Driver;         // chip driver, AUTO to pick from the board
     } I2C_LOCATION_T;
 
-using CallbackUShort = void (*)(ushort val);
+//#######################################################################
+// Binary board map.  A header, one fixed size record per board and the
+// name strings.  It is used where it sits, in a flash partition or a
+// mapped file, with the names pointed at in place.  The driver,
+// priority and first device of every board are resolved when the map
+// is made so loading it is a single pass.
+//#######################################################################
+#define I2C_MAP_MAGIC       0x4D5A      // "ZM"
+#define I2C_MAP_VERSION     1
+#define I2C_MUX_MAX         8           // TCA9548A addresses and outputs, -1 for none
+
+typedef struct
+    {
+    uint16_t    Magic;
+    uint16_t    Version;
+    uint16_t    BoardCount;
+    uint16_t    DeviceCount;    // channels on every board
+    uint32_t    Size;           // bytes in the whole map including names
+    } I2C_MAP_HEADER_T;
+
+typedef struct
+    {
+    int8_t      Cluster;
+    int8_t      Slice;
+    uint8_t     Port;
+    uint8_t     Bus;
+    uint8_t     NumberDtoA;
+    uint8_t     NumberAtoD;
+    uint8_t     NumberDigital;
+    I2C_PRIORITY Priority;      // never AUTO
+    I2C_DRIVER  Driver;         // never AUTO
+    uint8_t     Spare;
+    uint16_t    InputMask;
+    uint16_t    FirstDevice;    // device number of channel 0
+    uint16_t    NameOffset;     // from the start of the map
+    uint32_t    MaxClock;
+    } I2C_MAP_BOARD_T;
+
+typedef struct
+    {
+    const uint8_t*  pData;      // nullptr when not open
+    size_t          Size;
+    uint32_t        Handle;     // flash mapping on the ESP32
+    } I2C_MAP_FILE_T;
+
+using CallbackUShort  = void (*)(ushort val);
+using CallbackDigital = void (*)(short device, bool state);
+
+//#######################################################################
+// Transfer counters.  Each block only has one writer, the code driving
+// the bus, so the hot path increments without locking and readers
+// take a snapshot copy.
+//#######################################################################
+typedef struct
+    {
+    uint32_t    Transactions;       // bus transactions attempted
+    uint32_t    Bytes;              // data bytes moved, not counting address
+    uint32_t    NackAddress;        // no acknowledge of address
+    uint32_t    NackData;           // no acknowledge of data
+    uint32_t    Timeouts;
+    uint32_t    OtherErrors;        // buffer overrun, short reads and the rest
+    uint32_t    WireBits;           // bit times on the wire including start, address and stop
+    uint32_t    Quarantines;        // times the board was dropped from service
+    uint32_t    Recoveries;         // times a re-probe brought it back
+    uint32_t    Deferrals;          // flushes that carried this board forward for lack of budget
+    uint32_t    MaxDeferral;        // longest uSec an update was held back
+    } I2C_COUNTERS_T;
+
+//#######################################################################
+// Where the time in Begin went, all in uSec.  Bus times are measured on
+// each bus so with a fast start they overlap.
+//#######################################################################
+typedef struct
+    {
+    uint32_t    Tables;                     // building the board and device tables
+    uint32_t    Wire;                       // starting the controllers
+    uint32_t    Mux[I2C_BUS_COUNT];         // checking the mux chips
+    uint32_t    Probe[I2C_BUS_COUNT];       // finding the boards
+    uint32_t    Init[I2C_BUS_COUNT];        // board Init sequences
+    uint32_t    Total;
+    uint16_t    Found;                      // boards that answered
+    uint16_t    Missing;                    // boards quarantined at start
+    uint32_t    Selects;                    // mux select and deselect writes
+    uint32_t    FirstOutput;                // micros () since power on when the outputs were safe
+    uint32_t    Ready;                      // micros () when a staged start had every board up
+    bool        Fast;                       // fast start was used
+    bool        Staged;                     // BeginOutputs was used
+    } I2C_STARTUP_T;
+
+typedef struct
+    {
+    uint32_t        Time;           // millis () of this snapshot
+    uint32_t        Clock[I2C_BUS_COUNT];   // configured bus clocks, 0 if unused
+    I2C_COUNTERS_T  Total;          // all boards and mux traffic
+    I2C_COUNTERS_T  Mux;            // mux select traffic only
+    float           BytesPerSecond; // rates are since the previous snapshot
+    float           BusUtilization[I2C_BUS_COUNT];  // fraction of time each bus was busy
+    float           Utilization;    // busiest bus
+    float           EffectiveClock[I2C_BUS_COUNT];  // wire bits per busy second
+    uint32_t        ClockChanges[I2C_BUS_COUNT];    // setClock calls since the previous snapshot
+    uint32_t        DriverCalls[I2C_BUS_COUNT];     // I2C driver transactions since the previous snapshot
+    uint32_t        CallsSaved[I2C_BUS_COUNT];      // driver transactions avoided by batching
+    uint32_t        Deferred[I2C_BUS_COUNT];        // writes and polls carried forward since the previous snapshot
+    float           CallOverhead[I2C_BUS_COUNT];    // learned uSec of software time per driver call
+    float           FailureRate;    // failed transactions / transactions
+    } I2C_STATS_T;
 
 //#######################################################################
 class I2C_INTERFACE_C
     {
 private:
-    enum BOARD_TYPE
-        {
-        MCP4728 = 0,        // quad 12 bit digital to analog converter
-        MCP47FXBX8,         // hex  12 bit digital to analog converter
-        ADS1115,            // quad 16 bit analog to digital
-        PCF8575,            // 8 bit (PC8574A) & 16 bit (PCF8575) digital out without pullups
-        MCP23008,           // 8 bit digital out with pullups
-        };
+    struct I2C_DRIVER_S;
 
-    typedef struct
+    typedef struct I2C_BOARD_S
         {
         I2C_LOCATION_T  Board;              // This board access info
-        BOARD_TYPE      BoardType;          // one of the board types from enum
+        const I2C_DRIVER_S* pDriver;        // entry in the driver table
         bool            Valid;              // This board is valid
+        bool            Recover;            // probe answered, Init and shadow replay pending
+        uint8_t         Failures;           // consecutive failed transfers
+        uint16_t        ProbeDelay;         // current re-probe backoff in mSec
+        uint32_t        ProbeTime;          // millis () of the next re-probe
         uint16_t        NewDataMask;        // bits that represent data updates
+        uint32_t        Clock;              // clock used for this board
+        I2C_PRIORITY    Priority;
+        uint32_t        DeferStart;         // micros () when first deferred, 0 if up to date
+        short           FirstDevice;        // device number of channel 0
+        bool            InScan;             // already read in this input scan
+        uint16_t        InRaw;              // input pins at the last read
+        uint16_t        InStable;           // debounced input pins
+        uint16_t        InPending;          // pins that differ from the debounced state
+        uint16_t        InSince[16];        // millis () of each pin's last raw change
+        I2C_COUNTERS_T  Count;              // transfer counters for this board
+        uint8_t         TxLength;           // bytes in the transmit image
+        uint8_t         Tx[I2C_TX_MAX];     // transmit image.  Command bytes are fixed, data is written in place
         union
             {
-            union
-                {
-                uint8_t     ByteData[MAX_ANALOG_PER_BOARD * 2];
-                uint16_t    BitWord;
-                };
-            uint16_t    DtoA[MAX_ANALOG_PER_BOARD];
-            uint64_t    DataDtoA[2];
             uint16_t    AtoD[MAX_ANALOG_PER_BOARD / 2];
             uint64_t    DataAtoD;
-            uint16_t    DataDigital;
             };
         } I2C_BOARD_T;
+
+    //#######################################################################
+    // One entry per chip.  The hooks are plain member function pointers
+    // in a const table so a flush costs one indirect call per board and
+    // nothing virtual.
+    //#######################################################################
+    typedef struct I2C_DRIVER_S
+        {
+        const char* Name;
+        void     (I2C_INTERFACE_C::*Layout) (I2C_BOARD_T& brd, int& at_dev);   // channels into the transmit image
+        void     (I2C_INTERFACE_C::*Init)   (I2C_BOARD_T& brd);                // power up setup
+        void     (I2C_INTERFACE_C::*Flush)  (I2C_BOARD_T& brd);                // write the changed channels
+        uint16_t (I2C_INTERFACE_C::*Read)   (I2C_BOARD_T& brd);                // input pins or A/D channels read, nullptr if none
+        uint8_t  (I2C_INTERFACE_C::*Span)   (I2C_BOARD_T& brd, uint8_t*& ptx); // part of the image a flush sends
+        uint32_t (I2C_INTERFACE_C::*Bits)   (I2C_BOARD_T& brd);                // wire bits for one flush or poll
+        uint8_t  DtoA;                                                          // channels the chip has
+        uint8_t  AtoD;
+        uint8_t  Digital;
+        } I2C_DRIVER_T;
+
+    static const I2C_DRIVER_T _Drivers[(int)I2C_DRIVER::COUNT];
+    typedef struct
+        {
+        TwoWire*            pWire;
+        int                 Index;
+        int                 Sda;                // pins, -1 for the core default
+        int                 Scl;
+        uint32_t            Clock;              // base clock every part on the bus can handle
+        uint32_t            Current;            // clock now set on the controller
+        int                 Classes;            // distinct board clocks, ascending
+        uint32_t            Class[I2C_SPEED_CLASSES];
+        uint32_t            ClockChanges;
+        uint32_t            PrevChanges;
+        uint32_t            DriverCalls;        // transactions handed to the I2C driver
+        uint32_t            CallsSaved;         // transactions folded into batches
+        uint32_t            PrevCalls;
+        uint32_t            PrevSaved;
+        float               PrevBusy;           // busy seconds at the previous stats snapshot
+        uint32_t            Budget;             // uSec of wire time per Update, 0 for no limit
+        uint32_t            Spent;              // estimated uSec used since the start of Update
+        uint32_t            Deferred;           // writes and polls carried forward for lack of budget
+        uint32_t            PrevDeferred;
+        uint32_t            WireEst;            // estimated uSec of pure wire time since the start of Update
+        uint32_t            Overhead;           // learned software uSec per driver call, x16
+        int                 Next[(int)I2C_PRIORITY::COUNT];     // rotation start for each priority
+        uint8_t             LastEndT;
+        int                 Held;               // mux cluster left selected for a grouped Init, -1 for none
+        bool                Probing;            // bus task runs the fast start probe, not a flush
+        I2C_PRIORITY        Pass;               // priority the bus task flushes
+        uint8_t             ProbeErr;           // mux error found by the fast start probe
+        int                 BoardCount;         // boards assigned to this bus
+        I2C_COUNTERS_T      MuxCount;
+        uint32_t            PrevBits;           // wire bits at the previous stats snapshot
+        TaskHandle_t        Task;               // flush task, nullptr when flushed inline
+        I2C_INTERFACE_C*    pOwner;
+        } I2C_BUS_T;
+
     typedef struct I2C_DEVICE_S
         {
         I2C_BOARD_T*    pBoard;
-        uint16_t*       pDtoA;
-        uint16_t*       pDigital;
+        uint8_t*        pDtoA;          // big endian data word in the transmit image
+        uint8_t*        pDigital;       // byte in the transmit image holding this bit
         int             DevIndex;
         uint16_t*       pAtoD;
         uint8_t         DtoAain;
+        const CAL_CHANNEL_S* pCal;      // D/A correction, nullptr for none
+        SLEW_CHANNEL_S*      pSlew;     // rate limit ahead of the D/A, nullptr for none
             I2C_DEVICE_S (void) : pBoard(nullptr),
                                   pDtoA(nullptr),
-                                  pAtoD(nullptr),
                                   pDigital(nullptr),
-                                  DevIndex(0)
+                                  DevIndex(0),
+                                  pAtoD(nullptr),
+                                  pCal(nullptr),
+                                  pSlew(nullptr)
                 {}
         } I2C_DEVICE_T;
 
+    typedef struct
+        {
+        short           Device;
+        bool            State;
+        } I2C_INPUT_EVENT_T;
+
     I2C_BOARD_T*    _pBoard;
     I2C_DEVICE_T*   _pDevice;
     int             _DeviceCount;
     int             _BoardCount;
     ushort          _AtoD_loopDevice;
+    short           _AtoD_queued;           // StartAtoD made during a staged start, -1 for none
     CallbackUShort  _CallbackAtoD;
-    uint8_t         _LastEndT;
+    CallbackDigital _CallbackDigital;
+    int             _InputBoards;           // boards with input channels
+    uint16_t        _InputPeriod;           // mSec between input scans
+    uint32_t        _InputTime;             // millis () of the last input scan
+    uint32_t        _InputFull;             // millis () of the last scan of every input board
+    I2C_INPUT_EVENT_T _InEvent[I2C_INPUT_EVENTS];   // changes found by the scan, delivered after the lock is released
+    int             _InEvents;
+    int             _IntPin;                // GPIO wired to the expander interrupt lines, -1 for none
     bool            _DebugI2C;
+    I2C_BUS_T       _Bus[I2C_BUS_COUNT];
+    int             _BusesUsed;
+    bool            _Parallel;              // flush buses from their own tasks
+    bool            _Batch;                 // flush each mux slice as one command link
+    bool            _FastStart;             // probe and Init a mux slice at a time, buses in parallel
+    bool            _Offline;               // Update keeps the images but sends nothing, for replay
+    I2C_STARTUP_T   _Startup;
+    int             _StartNext;             // next board for the staged start, _BoardCount when done
+    TaskHandle_t    _pCaller;               // task waiting on the bus flush
+    SemaphoreHandle_t _Lock;                // held while any task is driving the buses
+    I2C_COUNTERS_T  _PrevTotal;             // totals at the previous stats snapshot
+    uint32_t        _PrevTime;
 
 
     void     BuildTables        (I2C_LOCATION_T* plocation);
+    bool     BuildTablesMap     (const uint8_t* pmap);
+    void     AddBoard           (I2C_BOARD_T& brd, const I2C_LOCATION_T& loc);
+    int      LayoutTables       (void);
+    int      Start              (uint64_t clock);
+    bool     StartWire          (uint64_t clock);
+    void     StartStep          (void);
+    void     BeginAtoD          (short device);
+    void     PrimeInputs        (I2C_BOARD_T& brd);
+    int      ProbeSerial        (void);
+    int      ProbeAll           (void);
+    void     ProbeBus           (I2C_BUS_T& bus);
+    void     Release            (void);
     char*    ErrorString        (int err);
     void     BusMux             (I2C_LOCATION_T& loc);
     void     EndBusMux          (I2C_LOCATION_T& loc);
+    uint8_t  EndTransmit        (I2C_BUS_T& bus, I2C_COUNTERS_T& count, uint8_t bytes);
+    void     CountRead          (I2C_COUNTERS_T& count, uint8_t received, uint8_t requested);
 
-    void     Write              (I2C_LOCATION_T& loc, uint8_t* buff, uint8_t length);
-    void     WriteByte          (uint8_t port, uint8_t data);
-    void     WriteRegisterByte  (uint8_t port, uint8_t addr, uint8_t data);
-    void     WriteRegisterWord  (uint8_t port, uint8_t addr, uint16_t data);
-    uint16_t ReadRegister16     (uint8_t port, uint8_t addr);
-    void     Init47FXBX8        (I2C_LOCATION_T &loc);
-    void     Init4728           (I2C_LOCATION_T &loc);
-    void     Init857x           (I2C_LOCATION_T &loc);
-    void     Init23008          (I2C_LOCATION_T &loc);
+    void     Write              (I2C_BOARD_T& brd, uint8_t* buff, uint8_t length);
+    void     WriteByte          (I2C_BOARD_T& brd, uint8_t data);
+    void     WriteRegisterByte  (I2C_BOARD_T& brd, uint8_t addr, uint8_t data);
+    void     WriteRegisterWord  (I2C_BOARD_T& brd, uint8_t addr, uint16_t data);
+    uint16_t ReadRegister16     (I2C_BOARD_T& brd, uint8_t addr);
+    void     Init47FXBX8        (I2C_BOARD_T& brd);
+    void     Init4728           (I2C_BOARD_T& brd);
+    void     Init857x           (I2C_BOARD_T& brd);
+    void     Init23008          (I2C_BOARD_T& brd);
     void     Write47FXBX8       (I2C_BOARD_T& board);
     void     Write4728          (I2C_BOARD_T& board);
     void     Write857x          (I2C_BOARD_T& board);
     void     Write23008         (I2C_BOARD_T& board);
+    void     LayoutDtoA         (I2C_BOARD_T& brd, int& at_dev, int step);
+    void     LayoutDigital      (I2C_BOARD_T& brd, int& at_dev, int base);
+    void     Layout47FXBX8      (I2C_BOARD_T& brd, int& at_dev);
+    void     Layout4728         (I2C_BOARD_T& brd, int& at_dev);
+    void     Layout857x         (I2C_BOARD_T& brd, int& at_dev);
+    void     Layout23008        (I2C_BOARD_T& brd, int& at_dev);
+    void     Layout1115         (I2C_BOARD_T& brd, int& at_dev);
+    uint16_t Read857x           (I2C_BOARD_T& brd);
+    uint16_t Read23008          (I2C_BOARD_T& brd);
+    uint16_t Read1115           (I2C_BOARD_T& brd);
+    uint8_t  SpanImage          (I2C_BOARD_T& brd, uint8_t*& ptx);
+    uint8_t  Span47FXBX8        (I2C_BOARD_T& brd, uint8_t*& ptx);
+    uint32_t BitsImage          (I2C_BOARD_T& brd);
+    uint32_t Bits1115           (I2C_BOARD_T& brd);
     uint8_t  DecodeIndex1115    (uint8_t index);
-    void     Init1115           (I2C_LOCATION_T &loc);
+    static bool DriverFits      (I2C_DRIVER driver, int dtoa, int atod, int digital);
+    void     Init1115           (I2C_BOARD_T& brd);
     void     Start1115          (I2C_DEVICE_T& device);
     bool     ValidateDevice     (ushort board);
+    void     InitBoard          (I2C_BOARD_T& brd);
+    void     Health             (I2C_BOARD_T& brd, uint8_t err);
+    void     Quarantine         (I2C_BOARD_T& brd);
+    void     Reprobe            (void);
+    void     FlushBus           (I2C_BUS_T& bus, I2C_PRIORITY prio);
+    bool     Pending            (I2C_BUS_T& bus, I2C_PRIORITY prio);
+    void     FlushClass         (I2C_BUS_T& bus, I2C_PRIORITY prio, uint32_t clock);
+    uint32_t WireTime           (I2C_BOARD_T& brd);
+    bool     Afford             (I2C_BUS_T& bus, I2C_BOARD_T& brd, uint32_t usec, bool first);
+    int      BoardCalls         (I2C_BOARD_T& brd);
+    void     Defer              (I2C_BUS_T& bus, I2C_BOARD_T& brd);
+    void     Written            (I2C_BOARD_T& brd);
+    void     SetBusClock        (I2C_BUS_T& bus, uint32_t clock);
+    void     WriteBoard         (I2C_BOARD_T& brd);
+    uint8_t  TxSpan             (I2C_BOARD_T& brd, uint8_t*& ptx);
+    bool     FlushSlice         (I2C_BUS_T& bus, I2C_BOARD_T** plist, int count);
+    uint16_t ReadInputs         (I2C_BOARD_T& brd);
+    void     Debounce           (I2C_BOARD_T& brd, uint16_t raw);
+    void     ScanInputs         (void);
+    bool     ReadSlice          (I2C_BUS_T& bus, I2C_BOARD_T** plist, uint16_t* praw, int count);
+    void     BuildSpeedClasses  (void);
+    void     StartBusTasks      (void);
+    static void BusTask         (void* arg);
 
 public:
          I2C_INTERFACE_C (void);
@@ -116,35 +440,126 @@ public:
          //         -1 = Total failure
          //         +X = Some interface errors
     int  Begin              (I2C_LOCATION_T* plocation, uint64_t clock);
+    int  BeginMap           (const uint8_t* pmap, size_t size, uint64_t clock);
+    int  BeginOutputs       (I2C_LOCATION_T* plocation, uint64_t clock);
+    int  Reconfigure        (const uint8_t* pmap, size_t size, uint64_t clock);
+    bool CheckMap           (const uint8_t* pmap, size_t size);
+    size_t MakeMap          (I2C_LOCATION_T* plocation, uint8_t* pbuf, size_t size);
+    bool OpenMap            (const char* name, I2C_MAP_FILE_T& file);
+    void CloseMap           (I2C_MAP_FILE_T& file);
     bool IsPortValid        (short device);
     void Loop               (void);
     bool IsAnalogIn         (short device);
     bool IsAnalogOut        (short device);
     bool IsDigitalOut       (short device);
+    bool IsDigitalIn        (short device);
+    bool DigitalIn          (short device);
     void D2Analog           (short device, ushort value);
+    void D2AnalogDirect     (short device, ushort value);
     void DigitalOut         (short device, bool value);
     void StartAtoD          (short device);
+    bool MeasureAtoD        (short device, int16_t& value);
+    void FlushDevice        (short device);
+    void SetCalibration     (short device, const CAL_CHANNEL_S* pcal);
+    void SetSlew            (short device, SLEW_CHANNEL_S* pslew);
     void AnalogClear        (void);
     void Update             (void);
-    void SetDebug           (bool state)
-        { _DebugI2C = state; }
-
-    //#######################################################################
-    void ResetAnalog (short device)
-        { this->Init1115(_pDevice[device].pBoard->Board); }
+    void FlushGates         (void);
+    void SetDebug           (bool state);
+    void GetStats           (I2C_STATS_T& stats);
+    bool BoardStats         (int board, I2C_COUNTERS_T& counters);
+    void ErrorTotals        (I2C_COUNTERS_T& total);
+    void ResetStats         (void);
+    void DumpStats          (void);
+    void DumpStartup        (void);
+    void SetBusPins         (int bus, int sda, int scl);
+    void SetBudget          (int bus, uint32_t usec);
+    void BalanceBuses       (I2C_LOCATION_T* plocation, int buses);
+    void BenchmarkFlush     (int passes);
+    void SetInputInterrupt  (int pin);
+    void ResetAnalog        (short device);
 
     //#######################################################################
     int  NumBoards (void)
         { return (this->_BoardCount); }
 
+    //#######################################################################
+    const char* BoardName (int board)
+        { return (this->_pBoard[board].Board.Name); }
+
     //#######################################################################
     int GetDeviceCount (void)
         { return (this->_DeviceCount); }
 
+    //#######################################################################
+    // Board a device is on and its channel on that board
+    //#######################################################################
+    const I2C_LOCATION_T& DeviceLocation (short device)
+        { return (this->_pDevice[device].pBoard->Board); }
+
+    int DeviceChannel (short device)
+        { return (this->_pDevice[device].DevIndex); }
+
+    //#######################################################################
+    void SetParallel (bool state)
+        { _Parallel = state; }
+
+    //#######################################################################
+    void SetBatch (bool state)
+        { _Batch = state; }
+
+    //#######################################################################
+    void SetFastStart (bool state)
+        { _FastStart = state; }
+
+    //#######################################################################
+    void SetOffline (bool state)
+        { _Offline = state; }
+
+    bool IsOffline (void)
+        { return (_Offline); }
+
+    //#######################################################################
+    void GetStartup (I2C_STARTUP_T& startup)
+        { startup = _Startup; }
+
+    //#######################################################################
+    void Lock (void)
+        { if ( _Lock ) xSemaphoreTake (_Lock, portMAX_DELAY); }
+
+    //#######################################################################
+    void Unlock (void)
+        { if ( _Lock ) xSemaphoreGive (_Lock); }
+
     //#######################################################################
     void SetCallbackAtoD (CallbackUShort fptr)
         { _CallbackAtoD = fptr; }
 
+    //#######################################################################
+    void SetCallbackDigital (CallbackDigital fptr)
+        { _CallbackDigital = fptr; }
+
+    //#######################################################################
+    // Input values reach the callbacks here, from the bus or a replay
+    //#######################################################################
+    void DeliverAtoD (ushort val)
+        {
+        REC_POINT (ATOD, 0, 0, (int32_t)val);
+        if ( _CallbackAtoD )
+            _CallbackAtoD (val);
+        }
+
+    void DeliverDigital (short device, bool state)
+        {
+        REC_POINT (DIGITAL, 0, device, (int32_t)state);
+        if ( _CallbackDigital )
+            _CallbackDigital (device, state);
+        }
+
+    //#######################################################################
+    void SetInputRate (uint16_t msec)
+        { _InputPeriod = msec; }
+
     };
 
 //#######################################################################
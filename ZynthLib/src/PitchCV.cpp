@@ -0,0 +1,245 @@
+//#######################################################################
+// Module:     PitchCV.cpp
+// Descrption: 1V/oct pitch outputs with scale quantization and glide
+// Creator:    markeby
+// Date:       10/19/2026
+//#######################################################################
+//host libraries
+#include <Arduino.h>
+
+//ZynthLib
+#include "PitchCV.h"
+#include "Calibrate.h"
+#include "I2Cdevices.h"
+#include "ZynthTime.h"
+#include "Debug.h"
+
+static const char* LabelError = "PITCH";
+#define ERROR(args...)    DEBUG_OUT (I2C_DA, DLEVEL_ERROR, ErrorMsg (LabelError, __FUNCTION__, args))
+
+//#######################################################################
+//#######################################################################
+    PITCH_CV_C::PITCH_CV_C ()
+    {
+    memset (_Channel, 0, sizeof (_Channel));
+    for ( int z = 0;  z < PITCH_CHANNELS;  z++ )
+        _Channel[z].Device = -1;
+    _Count    = 0;
+    _LastTick = 0;
+    }
+
+//#######################################################################
+bool PITCH_CV_C::Valid (int chan)
+    {
+    return ( chan >= 0 && chan < _Count );
+    }
+
+//#######################################################################
+// Sets up a D/A channel as a pitch output.  per_octave is the ideal D/A
+// counts for one volt and zero_note the MIDI note that sits at 0V.  The
+// channel calibration is applied by D2Analog so the table stays ideal.
+// Returns the pitch channel or -1.
+//#######################################################################
+int PITCH_CV_C::Add (short device, float per_octave, uint8_t zero_note)
+    {
+    if ( _Count >= PITCH_CHANNELS )
+        {
+        ERROR ("No pitch channels left for %d", device);
+        return (-1);
+        }
+    if ( device < 0 || device >= I2cDevices.GetDeviceCount () || !I2cDevices.IsAnalogOut (device) )
+        {
+        ERROR ("Device %d is not a D/A channel", device);
+        return (-1);
+        }
+
+    int              chan = _Count++;
+    PITCH_CHANNEL_T& ch   = _Channel[chan];
+
+    if ( chan == 0 )
+        _LastTick = ZyTime.Micros ();                   // so the first Loop does not see the time since boot
+
+    ch.Device      = device;
+    ch.PerSemitone = per_octave / 12.0f;
+    ch.pTable      = new int32_t[PITCH_NOTES];
+    for ( int z = 0;  z < PITCH_NOTES;  z++ )
+        {
+        float code = (z - zero_note) * ch.PerSemitone;
+        code = ( code < 0.0f ) ? 0.0f : (( code > CAL_DAC_MAX ) ? CAL_DAC_MAX : code);
+        ch.pTable[z] = lroundf (code * 65536.0f);
+        }
+    for ( int z = 0;  z < PITCH_NOTES;  z++ )
+        ch.Quant[z] = z;
+    ch.Note       = zero_note;
+    ch.Position   = ch.pTable[zero_note];
+    ch.Target     = ch.Position;
+    ch.LastCode   = 0xFFFF;
+    SetBendRange (chan, PITCH_BEND_RANGE);
+    Output (ch);
+    return (chan);
+    }
+
+//#######################################################################
+// Note plus bend plus fine tune, rounded to a D/A code.  Skips the write
+// when nothing has moved a whole count.
+//#######################################################################
+void PITCH_CV_C::Output (PITCH_CHANNEL_T& ch)
+    {
+    int32_t code = (ch.Position + ch.BendOffset + ch.Fine + 0x8000) >> 16;
+
+    code = ( code < 0 ) ? 0 : (( code > CAL_DAC_MAX ) ? CAL_DAC_MAX : code);
+    if ( code != ch.LastCode )
+        {
+        ch.LastCode = code;
+        I2cDevices.D2Analog (ch.Device, code);
+        }
+    }
+
+//#######################################################################
+// With glide on the rate is set here so that every glide takes the same
+// time however far it goes.  Loop () then only adds.
+//#######################################################################
+void PITCH_CV_C::NoteOn (int chan, uint8_t note)
+    {
+    if ( !Valid (chan) || note >= PITCH_NOTES )
+        return;
+
+    PITCH_CHANNEL_T& ch = _Channel[chan];
+
+    ch.Note   = ch.Quant[note];
+    ch.Target = ch.pTable[ch.Note];
+    if ( ch.Glide == 0 )
+        {
+        ch.Position = ch.Target;
+        Output (ch);
+        return;
+        }
+    ch.Rate = (int32_t)(abs ((int64_t)ch.Target - ch.Position) / ch.Glide);
+    if ( ch.Rate == 0 )
+        ch.Rate = 1;
+    }
+
+//#######################################################################
+// bend is the 14 bit MIDI value less 8192.  Bend is never glided.
+//#######################################################################
+void PITCH_CV_C::Bend (int chan, int16_t bend)
+    {
+    if ( !Valid (chan) )
+        return;
+
+    PITCH_CHANNEL_T& ch = _Channel[chan];
+
+    ch.Bend       = bend;
+    ch.BendOffset = bend * ch.BendScale;
+    Output (ch);
+    }
+
+//#######################################################################
+void PITCH_CV_C::SetBendRange (int chan, uint8_t semitones)
+    {
+    if ( !Valid (chan) )
+        return;
+
+    PITCH_CHANNEL_T& ch = _Channel[chan];
+
+    ch.BendScale  = lroundf (ch.PerSemitone * semitones * 65536.0f / 8192.0f);
+    ch.BendOffset = ch.Bend * ch.BendScale;
+    Output (ch);
+    }
+
+//#######################################################################
+void PITCH_CV_C::SetFine (int chan, int16_t cents)
+    {
+    if ( !Valid (chan) )
+        return;
+
+    PITCH_CHANNEL_T& ch = _Channel[chan];
+
+    ch.Fine = lroundf (ch.PerSemitone * cents * 65536.0f / 100.0f);
+    Output (ch);
+    }
+
+//#######################################################################
+// mask has bit 0 for the root through bit 11 for the major seventh.
+// Notes off the scale move to the nearest note on it, down on a tie.
+// A mask of zero or all twelve notes turns quantization off.
+//#######################################################################
+void PITCH_CV_C::SetScale (int chan, uint16_t mask, uint8_t root)
+    {
+    if ( !Valid (chan) )
+        return;
+
+    PITCH_CHANNEL_T& ch = _Channel[chan];
+
+    mask &= 0x0FFF;
+    root %= 12;                                         // keeps the shifts below positive
+    for ( int z = 0;  z < PITCH_NOTES;  z++ )
+        {
+        int q = z;
+
+        if ( mask != 0 && mask != 0x0FFF )
+            {
+            for ( int d = 0;  d <= 6;  d++ )
+                {
+                if ( z - d >= 0 && (mask & (1 << ((z - d - root + 120) % 12))) )
+                    {
+                    q = z - d;
+                    break;
+                    }
+                if ( z + d < PITCH_NOTES && (mask & (1 << ((z + d - root + 120) % 12))) )
+                    {
+                    q = z + d;
+                    break;
+                    }
+                }
+            }
+        ch.Quant[z] = q;
+        }
+    }
+
+//#######################################################################
+void PITCH_CV_C::SetGlide (int chan, uint16_t ms)
+    {
+    if ( !Valid (chan) )
+        return;
+    _Channel[chan].Glide = ms;
+    }
+
+//#######################################################################
+// Call ahead of I2cDevices.Update ().  Moves every gliding channel on by
+// the time since the last call.
+//#######################################################################
+void PITCH_CV_C::Loop ()
+    {
+    uint32_t now = ZyTime.Micros ();
+    uint32_t dt  = now - _LastTick;
+
+    _LastTick = now;
+    for ( int z = 0;  z < _Count;  z++ )
+        {
+        PITCH_CHANNEL_T& ch = _Channel[z];
+
+        if ( ch.Position == ch.Target )
+            continue;
+
+        int64_t step = ((int64_t)ch.Rate * dt) / 1000;
+        int32_t left = ch.Target - ch.Position;
+
+        if ( step >= abs (left) )
+            ch.Position = ch.Target;
+        else
+            ch.Position += ( left > 0 ) ? step : -step;
+        Output (ch);
+        }
+    }
+
+//#######################################################################
+// Next Loop times from now, for when the clock is swapped for a replay
+//#######################################################################
+void PITCH_CV_C::ResetClock ()
+    {
+    _LastTick = ZyTime.Micros ();
+    }
+
+//#######################################################################
+PITCH_CV_C PitchCV;
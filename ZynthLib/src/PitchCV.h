@@ -0,0 +1,64 @@
+//#######################################################################
+// Module:     PitchCV.h
+// Descrption: 1V/oct pitch outputs with scale quantization and glide
+// Creator:    markeby
+// Date:       10/19/2026
+//#######################################################################
+#pragma once
+
+#define PITCH_CHANNELS      16          // pitch outputs that can be set up
+#define PITCH_NOTES         128         // MIDI note range
+#define PITCH_BEND_RANGE    2           // default bend range in semitones
+
+//#######################################################################
+// All positions are D/A codes in Q16.  The note table is computed once
+// per channel so a note on is a table lookup and at most one D2Analog.
+//#######################################################################
+typedef struct
+    {
+    short       Device;                 // D/A channel, -1 when unused
+    int32_t*    pTable;                 // Q16 D/A code for each MIDI note
+    uint8_t     Quant[PITCH_NOTES];     // note each MIDI note plays after quantization
+    float       PerSemitone;            // D/A codes per semitone, for setup only
+    uint8_t     Note;                   // last note played after quantization
+    int32_t     Position;               // Q16 code the glide has reached
+    int32_t     Target;                 // Q16 code of the note
+    int32_t     Rate;                   // Q16 codes per mSec while gliding
+    uint16_t    Glide;                  // mSec for any glide, 0 for none
+    int32_t     BendScale;              // Q16 codes per unit of pitch bend
+    int32_t     BendOffset;             // Q16 codes from the current bend
+    int32_t     Fine;                   // Q16 codes of fine tune
+    int16_t     Bend;                   // last pitch bend, -8192 to 8191
+    uint16_t    LastCode;               // last value written, to skip repeats
+    } PITCH_CHANNEL_T;
+
+//#######################################################################
+class PITCH_CV_C
+    {
+private:
+    PITCH_CHANNEL_T _Channel[PITCH_CHANNELS];
+    int             _Count;
+    uint32_t        _LastTick;          // ZyTime.Micros () of the previous Loop
+
+    bool Valid              (int chan);
+    void Output             (PITCH_CHANNEL_T& ch);
+
+public:
+         PITCH_CV_C         (void);
+    int  Add                (short device, float per_octave, uint8_t zero_note);
+    void NoteOn             (int chan, uint8_t note);
+    void Bend               (int chan, int16_t bend);
+    void SetBendRange       (int chan, uint8_t semitones);
+    void SetFine            (int chan, int16_t cents);
+    void SetScale           (int chan, uint16_t mask, uint8_t root);
+    void SetGlide           (int chan, uint16_t ms);
+    void Loop               (void);
+    void ResetClock         (void);
+
+    //#######################################################################
+    int Channels (void)
+        { return (_Count); }
+    };
+
+//#######################################################################
+extern PITCH_CV_C PitchCV;
@@ -0,0 +1,536 @@
+//#######################################################################
+// Module:     Recorder.cpp
+// Descrption: Control event log for replay of the envelope engine
+// Creator:    markeby
+// Date:       10/19/2026
+//#######################################################################
+//host libraries
+#include <Arduino.h>
+#ifndef ESP_PLATFORM
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//ZynthLib
+#include "Recorder.h"
+#include "ZynthTime.h"
+#include "Envelope.h"
+#include "SoftLFO.h"
+#include "I2Cdevices.h"
+#include "Slew.h"
+#include "PitchCV.h"
+#include "Debug.h"
+
+static const char* LabelError = "REC";
+#define ERROR(args...)    DEBUG_OUT (ENV, DLEVEL_ERROR, ErrorMsg (LabelError, __FUNCTION__, args))
+
+#define BLOB_RECORDS(n)   (((n) + sizeof (REC_RECORD_T) - 1) / sizeof (REC_RECORD_T))
+
+//#######################################################################
+// First record of a log and the one after a record, stepping over blobs
+//#######################################################################
+static const REC_RECORD_T* FirstRecord (const uint8_t* plog)
+    {
+    return ((const REC_RECORD_T*)(plog + sizeof (REC_HEADER_T) + ((const REC_HEADER_T*)plog)->Envelopes * sizeof (REC_ENVELOPE_T)));
+    }
+
+static const REC_RECORD_T* NextRecord (const REC_RECORD_T* prec)
+    {
+    if ( prec->Id == (uint8_t)REC_ID::PARAMS || prec->Id == (uint8_t)REC_ID::PRESET )
+        return (prec + 1 + BLOB_RECORDS (prec->Arg));
+    return (prec + 1);
+    }
+
+//#######################################################################
+//#######################################################################
+    EVENT_RECORDER_C::EVENT_RECORDER_C ()
+    {
+    _pLog     = nullptr;
+    _pRecord  = nullptr;
+    _Capacity = 0;
+    _Count    = 0;
+    _Mask     = 0;
+    _Full     = false;
+    memset (_Group, 0, sizeof (_Group));
+    }
+
+//#######################################################################
+// Room for records of 8 bytes each, at least two per loop.  The current
+// envelope settings and software LFO go in first so a replay starts
+// from the same place.
+//#######################################################################
+bool EVENT_RECORDER_C::Start (uint32_t records, uint32_t mask)
+    {
+    int            count = EnvelopeGenerator.Count ();
+    size_t         head  = sizeof (REC_HEADER_T) + count * sizeof (REC_ENVELOPE_T);
+    const uint8_t* group[REC_GROUPS];
+    int            groups = 0;
+
+    if ( count > 255 )
+        {
+        ERROR ("Only the first 255 envelopes can be recorded");
+        return (false);
+        }
+    _Mask = 0;
+    delete[] _pLog;
+    _pLog = new uint8_t[head + records * sizeof (REC_RECORD_T)];
+    memset (_pLog, 0, head);
+
+    REC_HEADER_T*   phdr = (REC_HEADER_T*)_pLog;
+    REC_ENVELOPE_T* penv = (REC_ENVELOPE_T*)(_pLog + sizeof (REC_HEADER_T));
+
+    phdr->Magic      = REC_MAGIC;
+    phdr->Version    = REC_VERSION;
+    phdr->RecordSize = sizeof (REC_RECORD_T);
+    phdr->Mask       = mask;
+    phdr->Envelopes  = count;
+    for ( int z = 0;  z < count;  z++, penv++ )
+        {
+        ENVELOPE_C* pe = EnvelopeGenerator.Get (z);
+        int         g  = 0;
+
+        while ( g < groups && group[g] != pe->UseCount () )
+            g++;
+        if ( g == groups && groups < REC_GROUPS )
+            group[groups++] = pe->UseCount ();
+        penv->Device = pe->GetPortIO ();
+        penv->Range  = pe->GetRange ();
+        penv->Index  = pe->GetIndex ();
+        penv->Group  = g;
+        }
+
+    _pRecord  = (REC_RECORD_T*)(_pLog + head);
+    _Capacity = records;
+    _Count    = 0;
+    _Full     = false;
+    _Mask     = mask;
+    if ( Wants (REC_ID::PARAMS) )
+        {
+        for ( int z = 0;  z < count;  z++ )
+            {
+            ENV_PARAMS_T params;
+
+            EnvelopeGenerator.Get (z)->GetParams (params);
+            RecordBlob (REC_ID::PARAMS, z, &params, sizeof (params));
+            }
+        }
+    REC_POINT (LFO_COARSE, 0, 0, (int32_t)SoftLFO.GetFreqCoarse ());
+    REC_POINT (LFO_FINE,   0, 0, (int32_t)SoftLFO.GetFreqFine ());
+    REC_POINT (LFO_MIDI,   0, SoftLFO.GetMidi (), 0);
+    REC_POINT_F (LFO_MULT,  0, SoftLFO.GetMidi (), SoftLFO.GetModulation ());
+    REC_POINT_F (LFO_PHASE, 0, 0, SoftLFO.GetPhase ());
+    return (true);
+    }
+
+//#######################################################################
+void EVENT_RECORDER_C::Stop ()
+    {
+    _Mask = 0;
+    if ( _pLog )
+        ((REC_HEADER_T*)_pLog)->Count = _Count;
+    }
+
+//#######################################################################
+REC_RECORD_T* EVENT_RECORDER_C::Next (REC_ID id, uint8_t slot, uint16_t arg)
+    {
+    if ( _Count >= _Capacity )
+        {
+        _Full = true;
+        Stop ();
+        return (nullptr);
+        }
+
+    REC_RECORD_T* prec = &_pRecord[_Count++];
+
+    prec->Id   = (uint8_t)id;
+    prec->Slot = slot;
+    prec->Arg  = arg;
+    ((REC_HEADER_T*)_pLog)->Count = _Count;
+    return (prec);
+    }
+
+//#######################################################################
+// A record giving the size and then the data in whole records.  Nothing
+// is written unless all of it fits.
+//#######################################################################
+void EVENT_RECORDER_C::RecordBlob (REC_ID id, uint8_t slot, const void* pdata, uint16_t size)
+    {
+    if ( !Wants (id) )
+        return;
+    if ( _Count + 1 + BLOB_RECORDS (size) > _Capacity )
+        {
+        _Full = true;
+        Stop ();
+        return;
+        }
+    RecordI (id, slot, size, 0);
+    memcpy (&_pRecord[_Count], pdata, size);
+    _Count += BLOB_RECORDS (size);
+    ((REC_HEADER_T*)_pLog)->Count = _Count;
+    }
+
+//#######################################################################
+bool EVENT_RECORDER_C::Check (const uint8_t* plog, size_t size)
+    {
+    const REC_HEADER_T* phdr = (const REC_HEADER_T*)plog;
+
+    if ( size < sizeof (REC_HEADER_T) || phdr->Magic != REC_MAGIC )
+        {
+        ERROR ("Not an event log");
+        return (false);
+        }
+    if ( phdr->Version != REC_VERSION || phdr->RecordSize != sizeof (REC_RECORD_T) )
+        {
+        ERROR ("Event log version %d not supported", phdr->Version);
+        return (false);
+        }
+    if ( size < sizeof (REC_HEADER_T) + phdr->Envelopes * sizeof (REC_ENVELOPE_T) + (size_t)phdr->Count * sizeof (REC_RECORD_T) )
+        {
+        ERROR ("Event log is short");
+        return (false);
+        }
+    return (true);
+    }
+
+//#######################################################################
+// With no envelopes yet the set is made from the log, otherwise it has
+// to be the one the log was made with.
+//#######################################################################
+bool EVENT_RECORDER_C::Build (const REC_HEADER_T* phdr)
+    {
+    const REC_ENVELOPE_T* penv = (const REC_ENVELOPE_T*)(phdr + 1);
+
+    if ( EnvelopeGenerator.Count () == 0 )
+        {
+        memset (_Group, 0, sizeof (_Group));
+        for ( int z = 0;  z < phdr->Envelopes;  z++, penv++ )
+            EnvelopeGenerator.NewADSR (penv->Index, "Replay", penv->Device, penv->Range, _Group[penv->Group % REC_GROUPS]);
+        return (true);
+        }
+    if ( EnvelopeGenerator.Count () != phdr->Envelopes )
+        {
+        ERROR ("Log has %d envelopes, expected %d", phdr->Envelopes, EnvelopeGenerator.Count ());
+        return (false);
+        }
+    return (true);
+    }
+
+//#######################################################################
+void EVENT_RECORDER_C::Apply (const REC_RECORD_T* prec, REC_REPLAY_T& stats)
+    {
+    ENVELOPE_C* pe = EnvelopeGenerator.Get (prec->Slot);
+
+    switch ( (REC_ID)prec->Id )
+        {
+        case REC_ID::LOOP:
+            ZyTime.Advance (prec->I);
+            stats.Simulated += prec->I;
+            return;
+        case REC_ID::ENV_LOOP:
+            {
+            uint32_t zt = micros ();
+
+            EnvelopeGenerator.Loop ();
+            zt = micros () - zt;
+            stats.Loops++;
+            stats.LoopAvg += zt;
+            if ( zt > stats.LoopMax )
+                stats.LoopMax = zt;
+            }
+            return;
+        case REC_ID::PRESET:
+            EnvelopeGenerator.Recall ((const uint8_t*)(prec + 1), prec->Arg);
+            return;
+        case REC_ID::LFO_COARSE:
+            SoftLFO.SetFreqCoarse (prec->I);
+            return;
+        case REC_ID::LFO_FINE:
+            SoftLFO.SetFreqFine (prec->I);
+            return;
+        case REC_ID::LFO_FREQ:
+            SoftLFO.SetFreq (prec->I);
+            return;
+        case REC_ID::LFO_MIDI:
+            SoftLFO.SetMidi (prec->Arg);
+            return;
+        case REC_ID::LFO_MULT:
+            SoftLFO.Multiplier (prec->Arg, prec->F);
+            return;
+        case REC_ID::LFO_RESET:
+            SoftLFO.ResetControl ();
+            return;
+        case REC_ID::LFO_PHASE:
+            SoftLFO.SetPhase (prec->F);
+            return;
+        case REC_ID::ATOD:
+            I2cDevices.DeliverAtoD (prec->I);
+            return;
+        case REC_ID::DIGITAL:
+            I2cDevices.DeliverDigital (prec->Arg, prec->I);
+            return;
+        default:
+            break;
+        }
+
+    if ( pe == nullptr )
+        return;
+    switch ( (REC_ID)prec->Id )
+        {
+        case REC_ID::PARAMS:
+            pe->SetParams (*(const ENV_PARAMS_T*)(prec + 1));
+            pe->Update ();
+            break;
+        case REC_ID::START:
+            pe->Start ();
+            break;
+        case REC_ID::START_MOD:
+            pe->Start ((bool)prec->Arg);
+            break;
+        case REC_ID::END:
+            pe->End ();
+            break;
+        case REC_ID::MUTE:
+            pe->Mute (prec->Arg);
+            break;
+        case REC_ID::SET_TIME:
+            pe->SetTime ((ESTATE)prec->Arg, prec->F);
+            break;
+        case REC_ID::SET_LEVEL:
+            pe->SetLevel ((ESTATE)prec->Arg, prec->F);
+            break;
+        case REC_ID::SOFT_LFO:
+            pe->SetSoftLFO (prec->Arg);
+            break;
+        case REC_ID::DUAL_USE:
+            pe->SetDualUse (prec->Arg);
+            break;
+        case REC_ID::MOD_LEVEL:
+            pe->SetModulationLevel (prec->F);
+            break;
+        case REC_ID::OVERRIDE:
+            pe->SetOverride (prec->I);
+            break;
+        case REC_ID::DAMPER_MODE:
+            pe->SetDamperMode ((DAMPER)prec->Arg);
+            break;
+        case REC_ID::DAMPER:
+            pe->Damper (prec->Arg);
+            break;
+        case REC_ID::EXPRESSION:
+            pe->Expression (prec->F);
+            break;
+        default:
+            break;
+        }
+    }
+
+//#######################################################################
+// Runs a log back through the envelope engine as fast as it will go.
+// Loop times come from the log and drive slew and glide through the
+// replay clock, so the output is the same on any machine.  The bus is
+// taken offline and that output is recorded as a new log of envelope
+// loops and D/A writes of room for records.  Compare two of those to
+// find a change in behavior.
+//#######################################################################
+bool EVENT_RECORDER_C::Replay (const uint8_t* plog, size_t size, uint32_t records, REC_REPLAY_T& stats)
+    {
+    const REC_HEADER_T* phdr = (const REC_HEADER_T*)plog;
+
+    memset (&stats, 0, sizeof (stats));
+    if ( plog == _pLog )
+        {
+        ERROR ("Cannot replay into the log being replayed");
+        return (false);
+        }
+    if ( !Check (plog, size) || !Build (phdr) )
+        return (false);
+
+    const REC_RECORD_T* prec    = FirstRecord (plog);
+    const REC_RECORD_T* pend    = prec + phdr->Count;
+    uint32_t            zt      = micros ();
+    bool                setup   = true;         // settings ahead of the first loop go out before the output log starts
+    bool                ok      = true;
+    bool                offline = I2cDevices.IsOffline ();
+
+    _Mask = 0;
+    I2cDevices.SetOffline (true);
+    ZyTime.SetReplay (true);
+    SlewLimiter.ResetClock ();
+    PitchCV.ResetClock ();
+    while ( ok && prec < pend )
+        {
+        if ( setup && (prec->Id == (uint8_t)REC_ID::LOOP || prec->Id == (uint8_t)REC_ID::ENV_LOOP) )
+            {
+            setup = false;
+            if ( !Start (records, REC_OUTPUTS) )
+                {
+                ok = false;
+                break;
+                }
+            }
+        Apply (prec, stats);
+        stats.Records++;
+        prec = NextRecord (prec);
+        }
+    stats.Wall = micros () - zt;
+    if ( ok && setup )
+        ok = Start (records, REC_OUTPUTS);
+    Stop ();
+    ZyTime.SetReplay (false);
+    SlewLimiter.ResetClock ();
+    PitchCV.ResetClock ();
+    I2cDevices.SetOffline (offline);
+    if ( !ok )
+        return (false);
+
+    for ( uint32_t z = 0;  z < _Count;  z++ )
+        {
+        if ( _pRecord[z].Id == (uint8_t)REC_ID::DTOA )
+            stats.Writes++;
+        }
+    if ( stats.Loops )
+        stats.LoopAvg /= stats.Loops;
+    return (true);
+    }
+
+//#######################################################################
+// Checks a log against a golden one, both holding envelope loops and
+// D/A writes as a replay or a recording with REC_ALL leaves them.  The
+// code each device holds at the end of every loop is compared, so a
+// rework may change how often or in what order it writes but not what
+// reaches the D/A.  tolerance is in D/A counts.  True when every code
+// is within it and both ran the same loops.
+//#######################################################################
+bool EVENT_RECORDER_C::Compare (const uint8_t* pgold, size_t gsize, const uint8_t* plog, size_t size, uint16_t tolerance, REC_COMPARE_T& result)
+    {
+    memset (&result, 0, sizeof (result));
+    result.FirstDevice = -1;
+    if ( !Check (pgold, gsize) || !Check (plog, size) )
+        return (false);
+
+    const REC_RECORD_T* pg    = FirstRecord (pgold);
+    const REC_RECORD_T* pgend = pg + ((const REC_HEADER_T*)pgold)->Count;
+    const REC_RECORD_T* pl    = FirstRecord (plog);
+    const REC_RECORD_T* plend = pl + ((const REC_HEADER_T*)plog)->Count;
+    int                 count = 0;
+
+    for ( const REC_RECORD_T* p = pg;  p < pgend;  p = NextRecord (p) )
+        if ( p->Id == (uint8_t)REC_ID::DTOA && p->Arg >= count )
+            count = p->Arg + 1;
+    for ( const REC_RECORD_T* p = pl;  p < plend;  p = NextRecord (p) )
+        if ( p->Id == (uint8_t)REC_ID::DTOA && p->Arg >= count )
+            count = p->Arg + 1;
+
+    int32_t* pgcode = new int32_t[count * 2];       // golden then this log, -1 until written
+    int32_t* plcode = pgcode + count;
+    uint8_t* ptouch = new uint8_t[count];
+
+    memset (pgcode, 0xFF, count * 2 * sizeof (int32_t));
+    memset (ptouch, 0, count);
+    while ( pg < pgend || pl < plend )
+        {
+        // each side up to the end of its next loop
+        for ( ;  pg < pgend && pg->Id != (uint8_t)REC_ID::ENV_LOOP;  pg = NextRecord (pg) )
+            if ( pg->Id == (uint8_t)REC_ID::DTOA )
+                {
+                pgcode[pg->Arg] = pg->I;
+                ptouch[pg->Arg] = 1;
+                }
+        for ( ;  pl < plend && pl->Id != (uint8_t)REC_ID::ENV_LOOP;  pl = NextRecord (pl) )
+            if ( pl->Id == (uint8_t)REC_ID::DTOA )
+                {
+                plcode[pl->Arg] = pl->I;
+                ptouch[pl->Arg] = 1;
+                }
+
+        for ( int z = 0;  z < count;  z++ )
+            {
+            if ( !ptouch[z] )
+                continue;
+            ptouch[z] = 0;
+            result.Codes++;
+
+            uint16_t err = ( pgcode[z] < 0 || plcode[z] < 0 ) ? 0xFFFF : abs (pgcode[z] - plcode[z]);
+            if ( err > result.MaxError )
+                result.MaxError = err;
+            if ( err > tolerance )
+                {
+                if ( result.Over++ == 0 )
+                    {
+                    result.FirstLoop   = result.Loops;
+                    result.FirstDevice = z;
+                    }
+                }
+            }
+        if ( pg >= pgend || pl >= plend )
+            break;
+        pg = NextRecord (pg);
+        pl = NextRecord (pl);
+        result.Loops++;
+        }
+    result.LoopsMatch = ( pg >= pgend && pl >= plend );
+    delete[] pgcode;
+    delete[] ptouch;
+    return ( result.Over == 0 && result.LoopsMatch );
+    }
+
+//#######################################################################
+// Raw log out the serial port to be saved on the host.
+//#######################################################################
+void EVENT_RECORDER_C::DumpBinary ()
+    {
+    uint32_t mask = _Mask;
+
+    Stop ();
+    if ( _pLog )
+        Serial.write (_pLog, Size ());
+    _Mask = mask;
+    }
+
+#ifndef ESP_PLATFORM
+//#######################################################################
+bool EVENT_RECORDER_C::Save (const char* path)
+    {
+    size_t size = Size ();
+    bool   ok;
+
+    Stop ();
+    int fd = open (path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if ( fd < 0 )
+        return (false);
+    ok = ( write (fd, _pLog, size) == (ssize_t)size );
+    close (fd);
+    return (ok);
+    }
+
+//#######################################################################
+// Returns a copy of the file to give to Replay, delete[] when done.
+//#######################################################################
+uint8_t* EVENT_RECORDER_C::Load (const char* path, size_t& size)
+    {
+    struct stat st;
+    uint8_t*    pbuf = nullptr;
+
+    size = 0;
+    int fd = open (path, O_RDONLY);
+    if ( fd < 0 )
+        return (nullptr);
+    if ( fstat (fd, &st) == 0 && st.st_size > 0 )
+        {
+        pbuf = new uint8_t[st.st_size];
+        if ( read (fd, pbuf, st.st_size) == st.st_size )
+            size = st.st_size;
+        else
+            {
+            delete[] pbuf;
+            pbuf = nullptr;
+            }
+        }
+    close (fd);
+    return (pbuf);
+    }
+#endif
+
+//#######################################################################
+EVENT_RECORDER_C EventRecorder;
@@ -0,0 +1,193 @@
+//#######################################################################
+// Module:     Recorder.h
+// Descrption: Control event log for replay of the envelope engine
+// Creator:    markeby
+// Date:       10/19/2026
+//#######################################################################
+#pragma once
+
+#define RECORD_SYNTH        1           // comment out to remove all record points at compile time
+
+#define REC_MAGIC           0x5A524543  // "ZREC"
+#define REC_VERSION         1
+#define REC_GROUPS          32          // distinct use counters a log can rebuild
+
+//#####################################
+// Record identifiers
+//#####################################
+enum class REC_ID : uint8_t
+    {
+    LOOP = 0,           // ZyTime.Loop ()               I = interval in uSec
+    ENV_LOOP,           // EnvelopeGenerator.Loop ()    F = interval in mSec
+    PARAMS,             // envelope settings            Arg = bytes of ENV_PARAMS_T that follow
+    PRESET,             // EnvelopeGenerator.Recall ()  Arg = bytes of the image that follow
+    START,              // ENVELOPE_C::Start ()
+    START_MOD,          // ENVELOPE_C::Start (bool)     Arg = modstate
+    END,
+    MUTE,               // Arg = state
+    SET_TIME,           // Arg = ESTATE                 F = time
+    SET_LEVEL,          // Arg = ESTATE                 F = level
+    SOFT_LFO,           // Arg = state
+    DUAL_USE,           // Arg = state
+    MOD_LEVEL,          // F = level
+    OVERRIDE,           // I = D/A value
+    DAMPER_MODE,        // Arg = DAMPER
+    DAMPER,             // Arg = state
+    EXPRESSION,         // F = level
+    LFO_COARSE,         // I = value
+    LFO_FINE,           // I = value
+    LFO_FREQ,           // I = value
+    LFO_MIDI,           // Arg = channel
+    LFO_MULT,           // Arg = channel                F = value
+    LFO_RESET,
+    LFO_PHASE,          // F = mSec into the wave
+    ATOD,               // I = A/D value given to the callback
+    DIGITAL,            // Arg = device                 I = state given to the callback
+    DTOA,               // Arg = device                 I = code after calibration
+    COUNT
+    };
+
+#define REC_BIT(id)         (1UL << (int)REC_ID::id)
+#define REC_OUTPUTS         (REC_BIT (ENV_LOOP) | REC_BIT (DTOA))
+#define REC_INPUTS          (((1UL << (int)REC_ID::COUNT) - 1) & ~REC_BIT (DTOA))
+#define REC_ALL             ((1UL << (int)REC_ID::COUNT) - 1)
+
+//#######################################################################
+// A log is this header, one REC_ENVELOPE_T per envelope in creation
+// order, then the records.  Blobs follow their record padded out to
+// whole records.
+//#######################################################################
+typedef struct
+    {
+    uint32_t    Magic;
+    uint16_t    Version;
+    uint16_t    RecordSize;     // sizeof (REC_RECORD_T) it was written with
+    uint32_t    Count;          // records
+    uint32_t    Mask;           // REC_BIT of each kind recorded
+    uint16_t    Envelopes;
+    uint16_t    Spare;
+    } REC_HEADER_T;
+
+typedef struct
+    {
+    uint16_t    Device;         // as given to NewADSR
+    uint16_t    Range;
+    uint8_t     Index;
+    uint8_t     Group;          // envelopes sharing a use counter share a group
+    uint16_t    Spare;
+    } REC_ENVELOPE_T;
+
+typedef struct
+    {
+    uint8_t     Id;             // REC_ID
+    uint8_t     Slot;           // envelope in creation order
+    uint16_t    Arg;
+    union
+        {
+        float   F;
+        int32_t I;
+        };
+    } REC_RECORD_T;
+
+typedef struct
+    {
+    uint32_t    Records;        // read from the log
+    uint32_t    Loops;          // envelope loops run
+    uint32_t    Writes;         // D/A writes in the output log
+    uint64_t    Simulated;      // uSec of instrument time replayed
+    uint32_t    Wall;           // uSec the replay took
+    uint32_t    LoopMax;        // slowest envelope loop in uSec
+    float       LoopAvg;
+    } REC_REPLAY_T;
+
+typedef struct
+    {
+    uint32_t    Loops;          // envelope loops compared
+    uint32_t    Codes;          // device codes compared at the end of each loop
+    uint32_t    Over;           // codes beyond the tolerance
+    uint16_t    MaxError;       // largest difference in D/A counts
+    uint32_t    FirstLoop;      // loop of the first code beyond the tolerance
+    short       FirstDevice;    // and its device, -1 for none
+    bool        LoopsMatch;     // both logs ran the same number of loops
+    } REC_COMPARE_T;
+
+//#######################################################################
+// Recording and replay run on the task that runs the loop.  Start the
+// recording with every envelope idle, a replay starts from rest.
+//#######################################################################
+class EVENT_RECORDER_C
+    {
+private:
+    uint8_t*        _pLog;
+    REC_RECORD_T*   _pRecord;       // first record in _pLog
+    uint32_t        _Capacity;      // records that fit
+    uint32_t        _Count;
+    uint32_t        _Mask;          // 0 when not recording
+    bool            _Full;
+    uint8_t         _Group[REC_GROUPS];     // use counters for a rebuilt envelope set
+
+    REC_RECORD_T* Next (REC_ID id, uint8_t slot, uint16_t arg);
+    bool          Check (const uint8_t* plog, size_t size);
+    bool          Build (const REC_HEADER_T* phdr);
+    void          Apply (const REC_RECORD_T* prec, REC_REPLAY_T& stats);
+
+public:
+             EVENT_RECORDER_C   (void);
+    bool     Start              (uint32_t records, uint32_t mask = REC_INPUTS);
+    void     Stop               (void);
+    void     RecordBlob         (REC_ID id, uint8_t slot, const void* pdata, uint16_t size);
+    bool     Replay             (const uint8_t* plog, size_t size, uint32_t records, REC_REPLAY_T& stats);
+    bool     Compare            (const uint8_t* pgold, size_t gsize, const uint8_t* plog, size_t size, uint16_t tolerance, REC_COMPARE_T& result);
+    void     DumpBinary         (void);
+#ifndef ESP_PLATFORM
+    bool     Save               (const char* path);
+    uint8_t* Load               (const char* path, size_t& size);
+#endif
+
+    //#######################################################################
+    bool Wants (REC_ID id)
+        { return (_Mask & (1UL << (int)id)); }
+
+    bool IsFull (void)
+        { return (_Full); }
+
+    uint32_t Count (void)
+        { return (_Count); }
+
+    const uint8_t* Log (void)
+        { return (_pLog); }
+
+    size_t Size (void)                      // bytes of the log so far
+        { return (( _pLog ) ? ((uint8_t*)(_pRecord + _Count) - _pLog) : 0); }
+
+    //#######################################################################
+    // Only copies the values in.  A full log stops recording.  Named by
+    // the half of the union they fill since int32_t is a long on some
+    // cores and a plain 0 would then match neither better.
+    //#######################################################################
+    void RecordI (REC_ID id, uint8_t slot, uint16_t arg, int32_t value)
+        {
+        REC_RECORD_T* prec = Next (id, slot, arg);
+        if ( prec )
+            prec->I = value;
+        }
+
+    void RecordF (REC_ID id, uint8_t slot, uint16_t arg, float value)
+        {
+        REC_RECORD_T* prec = Next (id, slot, arg);
+        if ( prec )
+            prec->F = value;
+        }
+    };
+
+//#######################################################################
+extern EVENT_RECORDER_C EventRecorder;
+
+// REC_POINT_F for the records that carry F
+#ifdef RECORD_SYNTH
+#define REC_POINT(id, slot, arg, value)     { if ( EventRecorder.Wants (REC_ID::id) ) EventRecorder.RecordI (REC_ID::id, (slot), (arg), (value)); }
+#define REC_POINT_F(id, slot, arg, value)   { if ( EventRecorder.Wants (REC_ID::id) ) EventRecorder.RecordF (REC_ID::id, (slot), (arg), (value)); }
+#else
+#define REC_POINT(id, slot, arg, value)
+#define REC_POINT_F(id, slot, arg, value)
+#endif
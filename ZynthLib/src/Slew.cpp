@@ -0,0 +1,181 @@
+//#######################################################################
+// Module:     Slew.cpp
+// Descrption: Rise and fall rate limiting between D2Analog and the D/A
+// Creator:    markeby
+// Date:       10/19/2026
+//#######################################################################
+//host libraries
+#include <Arduino.h>
+
+//ZynthLib
+#include "Slew.h"
+#include "I2Cdevices.h"
+#include "ZynthTime.h"
+#include "Debug.h"
+
+static const char* LabelError = "SLEW";
+#define ERROR(args...)    DEBUG_OUT (I2C_DA, DLEVEL_ERROR, ErrorMsg (LabelError, __FUNCTION__, args))
+
+//#######################################################################
+//#######################################################################
+    SLEW_C::SLEW_C ()
+    {
+    _pChannel    = nullptr;
+    _pActive     = nullptr;
+    _ActiveCount = 0;
+    _Count       = 0;
+    _LastTick    = 0;
+    }
+
+//#######################################################################
+// Call after I2cDevices.Begin ().  No channel is limited until Set ().
+//#######################################################################
+void SLEW_C::Begin ()
+    {
+    delete[] _pChannel;                                 // again after a Reconfigure
+    delete[] _pActive;
+    _ActiveCount = 0;
+    _Count    = I2cDevices.GetDeviceCount ();
+    _pChannel = new SLEW_CHANNEL_T[_Count];
+    _pActive  = new SLEW_CHANNEL_T*[_Count];
+    memset (_pChannel, 0, _Count * sizeof (SLEW_CHANNEL_T));
+    for ( int z = 0;  z < _Count;  z++ )
+        _pChannel[z].Device = z;
+    _LastTick = ZyTime.Micros ();
+    }
+
+//#######################################################################
+// Drop every channel with nothing written, called with the bus lock
+// held while the device tables are swapped.  Begin () sets the stage
+// up again for the new devices.
+//#######################################################################
+void SLEW_C::Reset ()
+    {
+    delete[] _pChannel;
+    delete[] _pActive;
+    _pChannel    = nullptr;
+    _pActive     = nullptr;
+    _ActiveCount = 0;
+    _Count       = 0;
+    }
+
+//#######################################################################
+// Times are mSec to move the full D/A range in each direction.  Both
+// zero takes the channel out of the stage.
+//#######################################################################
+void SLEW_C::Set (short device, float rise_ms, float fall_ms)
+    {
+    if ( device < 0 || device >= _Count || !I2cDevices.IsAnalogOut (device) )
+        {
+        ERROR ("Device %d is not a D/A channel", device);
+        return;
+        }
+
+    SLEW_CHANNEL_T& ch = _pChannel[device];
+
+    ch.Rise = ( rise_ms > 0 ) ? max (1L, lroundf (SLEW_FULL_SCALE * 65536.0f / (rise_ms * 1000.0f))) : 0;
+    ch.Fall = ( fall_ms > 0 ) ? max (1L, lroundf (SLEW_FULL_SCALE * 65536.0f / (fall_ms * 1000.0f))) : 0;
+    if ( ch.Rise == 0 && ch.Fall == 0 )
+        {
+        Clear (device);
+        return;
+        }
+    I2cDevices.SetSlew (device, &ch);
+    }
+
+//#######################################################################
+void SLEW_C::Clear (short device)
+    {
+    if ( device < 0 || device >= _Count )
+        return;
+
+    SLEW_CHANNEL_T& ch = _pChannel[device];
+
+    I2cDevices.SetSlew (device, nullptr);
+    if ( ch.Active )
+        {
+        for ( int z = 0;  z < _ActiveCount;  z++ )
+            {
+            if ( _pActive[z] == &ch )
+                {
+                _pActive[z] = _pActive[--_ActiveCount];
+                break;
+                }
+            }
+        I2cDevices.D2AnalogDirect (device, ch.Target >> 16);       // finish where it was headed
+        }
+    ch.Active = false;
+    ch.Primed = false;
+    }
+
+//#######################################################################
+// From D2Analog.  Only records the new target, the pass does the rest.
+// The D/A range is all Q16 has room for so larger values are clamped.
+//#######################################################################
+void SLEW_C::Target (SLEW_CHANNEL_T& ch, uint16_t value)
+    {
+    if ( value > SLEW_FULL_SCALE )
+        value = SLEW_FULL_SCALE;
+    ch.Target = (int32_t)value << 16;
+    if ( !ch.Primed )
+        {
+        ch.Primed   = true;
+        ch.Current  = ch.Target;
+        ch.LastCode = value;
+        I2cDevices.D2AnalogDirect (ch.Device, value);
+        return;
+        }
+    if ( !ch.Active && ch.Current != ch.Target )
+        {
+        ch.Active = true;
+        _pActive[_ActiveCount++] = &ch;
+        }
+    }
+
+//#######################################################################
+// One pass over the moving channels each Update ().  Channels that land
+// on their target are dropped from the list as it is walked.
+//#######################################################################
+void SLEW_C::Process ()
+    {
+    uint32_t now = ZyTime.Micros ();
+    uint32_t dt  = now - _LastTick;
+    int      n   = 0;
+
+    _LastTick = now;
+    for ( int z = 0;  z < _ActiveCount;  z++ )
+        {
+        SLEW_CHANNEL_T& ch   = *_pActive[z];
+        int32_t         left = ch.Target - ch.Current;
+        int32_t         rate = ( left > 0 ) ? ch.Rise : ch.Fall;
+        int64_t         step = (int64_t)rate * dt;
+
+        if ( rate == 0 || step >= abs (left) )
+            ch.Current = ch.Target;
+        else
+            ch.Current += ( left > 0 ) ? step : -step;
+
+        uint16_t code = (ch.Current + 0x8000) >> 16;
+        if ( code != ch.LastCode )
+            {
+            ch.LastCode = code;
+            I2cDevices.D2AnalogDirect (ch.Device, code);
+            }
+        if ( ch.Current != ch.Target )
+            _pActive[n++] = &ch;
+        else
+            ch.Active = false;
+        }
+    _ActiveCount = n;
+    }
+
+//#######################################################################
+// Next pass times from now, for when the clock is swapped for a replay
+//#######################################################################
+void SLEW_C::ResetClock ()
+    {
+    _LastTick = ZyTime.Micros ();
+    }
+
+//#######################################################################
+SLEW_C SlewLimiter;
@@ -0,0 +1,56 @@
+//#######################################################################
+// Module:     Slew.h
+// Descrption: Rise and fall rate limiting between D2Analog and the D/A
+// Creator:    markeby
+// Date:       10/19/2026
+//#######################################################################
+#pragma once
+
+#define SLEW_FULL_SCALE     4095        // D/A counts the rate times are given for
+
+//#######################################################################
+// Values are D/A counts in Q16 and rates Q16 counts per uSec, with a
+// rate of zero passing that direction straight through.
+//#######################################################################
+typedef struct SLEW_CHANNEL_S
+    {
+    short       Device;
+    int32_t     Current;        // value the output has reached
+    int32_t     Target;         // last value given to D2Analog
+    int32_t     Rise;
+    int32_t     Fall;
+    uint16_t    LastCode;       // last code written, to skip repeats
+    bool        Primed;         // first value goes straight out
+    bool        Active;         // in the pass until the target is reached
+    } SLEW_CHANNEL_T;
+
+//#######################################################################
+// Every channel still moving is kept in one list so the pass in
+// I2cDevices.Update () only touches those.
+//#######################################################################
+class SLEW_C
+    {
+private:
+    SLEW_CHANNEL_T*     _pChannel;      // one per I2C device, D/A channels only used
+    SLEW_CHANNEL_T**    _pActive;
+    int                 _ActiveCount;
+    int                 _Count;
+    uint32_t            _LastTick;      // ZyTime.Micros () of the previous pass
+
+public:
+         SLEW_C             (void);
+    void Begin              (void);
+    void Reset              (void);
+    void Set                (short device, float rise_ms, float fall_ms);
+    void Clear              (short device);
+    void Target             (SLEW_CHANNEL_T& ch, uint16_t value);
+    void Process            (void);
+    void ResetClock         (void);
+
+    //#######################################################################
+    int Moving (void)
+        { return (_ActiveCount); }
+    };
+
+//#######################################################################
+extern SLEW_C SlewLimiter;
@@ -25,12 +25,24 @@
 //#######################################################################
 void SOFT_LFO_C::SetFreqFine (short value)
     {
+    REC_POINT (LFO_FINE, 0, 0, (int32_t)value);
     if ( value == 0 )
         value = 1;
     _FreqFine = value;
     ProcessFreq ();
     }
 //#######################################################################
+// Preset recall.  Sets everything then works out the frequency once.
+//#######################################################################
+void SOFT_LFO_C::Restore (short coarse, short fine, byte mchan)
+    {
+    _FreqCoarse = coarse;
+    _FreqFine   = ( fine == 0 ) ? 1 : fine;
+    _Midi       = mchan;
+    ProcessFreq ();
+    }
+
+//#######################################################################
 void SOFT_LFO_C::ProcessFreq ()
     {
     _Freq = (_FreqCoarse * MIDI_MULTIPLIER) + _FreqFine;
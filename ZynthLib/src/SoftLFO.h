@@ -5,6 +5,7 @@
 // Date:       7/05/2024
 //#######################################################################
 #pragma once
+#include "Recorder.h"
 
 //#######################################################################
 //#######################################################################
@@ -28,16 +29,22 @@ private:
 public:
           SOFT_LFO_C    (void);
     void  Loop          (void);
-    void  ResetControl  (void)                      {  _Modulation = 0; }
-    void  Multiplier    (byte mchan, float value)   { if ( mchan == _Midi ) _Modulation = value; }
-    void  SetMidi       (byte mchan)                { _Midi = mchan; }
+    void  ResetControl  (void)                      { REC_POINT (LFO_RESET, 0, 0, 0);  _Modulation = 0; }
+    void  Multiplier    (byte mchan, float value)   { REC_POINT_F (LFO_MULT, 0, mchan, value); if ( mchan == _Midi ) _Modulation = value; }
+    void  SetMidi       (byte mchan)                { REC_POINT (LFO_MIDI, 0, mchan, 0); _Midi = mchan; }
     byte  GetMidi       (void)                      { return (_Midi); }
     float GetTri        (void)                      { return (_Triangle * _Modulation); }
     float GetSin        (void)                      { return (_Sine * _Modulation); }
-    void  SetFreqCoarse (short value)               { _FreqCoarse = value; ProcessFreq (); }
+    void  SetFreqCoarse (short value)               { REC_POINT (LFO_COARSE, 0, 0, (int32_t)value); _FreqCoarse = value; ProcessFreq (); }
     void  SetFreqFine   (short value);
     short GetFreq       (void)                      { return (_Freq); }
-    void  SetFreq       (short value)               { _Freq = value; OutputFrequency (); }
+    short GetFreqCoarse (void)                      { return (_FreqCoarse); }
+    short GetFreqFine   (void)                      { return (_FreqFine); }
+    float GetModulation (void)                      { return (_Modulation); }
+    float GetPhase      (void)                      { return (_Current); }
+    void  SetPhase      (float ms)                  { _Current = ms; }
+    void  Restore       (short coarse, short fine, byte mchan);
+    void  SetFreq       (short value)               { REC_POINT (LFO_FREQ, 0, 0, (int32_t)value); _Freq = value; OutputFrequency (); }
     };
 
 //#######################################################################
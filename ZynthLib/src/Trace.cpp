@@ -0,0 +1,148 @@
+//#######################################################################
+// Module:     Trace.cpp
+// Descrption: Hot path trace points recorded to a binary ring buffer
+// Creator:    markeby
+// Date:       10/19/2026
+//#######################################################################
+//host libraries
+#include <Arduino.h>
+
+//ZynthLib
+#include "Trace.h"
+
+static const char* traceName[] = { "ENV_LOOP", "ENV_PROCESS", "ENV_ACTIVE", "I2C_UPDATE", "I2C_BUSMUX", "I2C_READ16" };
+static const char  tracePhase[] = { 'B', 'E', 'C' };
+
+#define TRACE_MAGIC     0x5A545243      // "ZTRC"
+
+//#######################################################################
+//#######################################################################
+    TRACE_C::TRACE_C ()
+    {
+    _Enabled    = false;
+    _pCrumb     = nullptr;
+    _pCrumbHead = nullptr;
+    Clear ();
+    }
+
+//#######################################################################
+const char* TRACE_C::Name (uint8_t id)
+    {
+    id &= ~TRACE_CORE_BIT;
+    return (( id < (uint8_t)TRACE_ID::COUNT ) ? traceName[id] : "?");
+    }
+
+//#######################################################################
+void TRACE_C::Clear ()
+    {
+    _Head.store (0);
+    memset (_Ring, 0, sizeof (_Ring));
+    }
+
+//#######################################################################
+// Copy of a record, false while a writer is part way through it
+//#######################################################################
+bool TRACE_C::Fetch (uint32_t index, TRACE_RECORD_T& rec)
+    {
+    TRACE_RECORD_T& slot = _Ring[index & (TRACE_DEPTH - 1)];
+    uint8_t         type = __atomic_load_n (&slot.Type, __ATOMIC_ACQUIRE);
+
+    if ( type == TRACE_FILLING )
+        return (false);
+    rec.Cycles = slot.Cycles;
+    rec.Id     = slot.Id;
+    rec.Arg    = slot.Arg;
+    rec.Value  = slot.Value;
+    rec.Type   = type;
+    std::atomic_thread_fence (std::memory_order_acquire);
+    return ( __atomic_load_n (&slot.Type, __ATOMIC_RELAXED) == type );
+    }
+
+//#######################################################################
+// Output the ring as Chrome trace event JSON.  Capture the serial output
+// to a .json file and load it with chrome://tracing or ui.perfetto.dev.
+// Recording is paused for the duration of the dump.  Each core is its
+// own thread.  A slot can be taken out of cycle order by a task that
+// preempts the writer, so time moves by the signed difference from the
+// previous record of the same core.  A core's first record starts at
+// the time reached on the other, which lines the two up to within the
+// ring order.
+//#######################################################################
+void TRACE_C::DumpJSON ()
+    {
+    bool     state   = _Enabled;
+    uint32_t head    = _Head.load ();
+    uint32_t count   = Count ();
+    float    mhz     = ESP.getCpuFreqMHz ();
+    int64_t  now     = 0;               // cycles from the first record
+    int64_t  at[2]   = { 0, 0 };        // per core
+    uint32_t last[2] = { 0, 0 };
+    bool     seen[2] = { false, false };
+    bool     more    = false;           // a record is out, the next needs a comma
+
+    _Enabled = false;
+    printf ("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for ( uint32_t z = 0;  z < count;  z++ )
+        {
+        TRACE_RECORD_T rec;
+
+        if ( !Fetch (head - count + z, rec) )
+            continue;
+
+        int     core = ( rec.Id & TRACE_CORE_BIT ) ? 1 : 0;
+        uint8_t id   = rec.Id & ~TRACE_CORE_BIT;
+
+        if ( seen[core] )
+            at[core] += (int32_t)(rec.Cycles - last[core]);
+        else
+            at[core] = now;
+        seen[core] = true;
+        last[core] = rec.Cycles;
+        now        = at[core];
+
+        double ts = (double)now / mhz;
+        if ( id >= (uint8_t)TRACE_ID::COUNT || rec.Type > (uint8_t)TRACE_TYPE::COUNTER )
+            continue;
+        if ( more )
+            printf (",\n");
+        more = true;
+        if ( rec.Type == (uint8_t)TRACE_TYPE::COUNTER )
+            printf ("{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":0,\"tid\":%d,\"args\":{\"value\":%d}}",
+                    traceName[id], ts, core, rec.Value);
+        else
+            printf ("{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":0,\"tid\":%d,\"args\":{\"arg\":%d}}",
+                    traceName[id], tracePhase[rec.Type], ts, core, rec.Arg);
+        }
+    printf ("\n]}\n");
+    _Enabled = state;
+    }
+
+//#######################################################################
+// Raw dump of the ring, oldest record first, preceded by a header of
+// magic, record count and CPU MHz as 32 bit little endian words.  The
+// core is in the top bit of Id and its cycles only compare with its own.
+//#######################################################################
+void TRACE_C::DumpBinary ()
+    {
+    bool     state = _Enabled;
+    uint32_t head  = _Head.load ();
+    uint32_t hdr[3];
+
+    _Enabled = false;
+    hdr[0] = TRACE_MAGIC;
+    hdr[1] = Count ();
+    hdr[2] = ESP.getCpuFreqMHz ();
+    Serial.write ((uint8_t*)hdr, sizeof (hdr));
+    for ( uint32_t z = 0;  z < hdr[1];  z++ )
+        {
+        TRACE_RECORD_T rec;
+
+        if ( !Fetch (head - hdr[1] + z, rec) )
+            rec.Type = TRACE_FILLING;           // kept so the count holds, readers skip it
+        Serial.write ((uint8_t*)&rec, sizeof (TRACE_RECORD_T));
+        }
+    _Enabled = state;
+    }
+
+//#######################################################################
+TRACE_C Tracer;
@@ -0,0 +1,150 @@
+//#######################################################################
+// Module:     Trace.h
+// Descrption: Hot path trace points recorded to a binary ring buffer
+// Creator:    markeby
+// Date:       10/19/2026
+//#######################################################################
+#pragma once
+#include <atomic>
+
+#define TRACE_SYNTH         1           // comment out to remove all trace points at compile time
+
+#define TRACE_DEPTH         1024        // records in the ring.  Must be a power of two
+#define TRACE_CRUMB_DEPTH   32          // newest records also kept for Breadcrumbs.  Must be a power of two
+#define TRACE_FILLING       0xFF        // Type of a record still being written
+#define TRACE_CORE_BIT      0x80        // set in Id for a record made on core 1
+
+//#####################################
+// Trace point identifiers
+//#####################################
+enum class TRACE_ID : uint8_t
+    {
+    ENV_LOOP = 0,       // ENV_GENERATOR_C::Loop
+    ENV_PROCESS,        // ENVELOPE_C::Process          arg = envelope index
+    ENV_ACTIVE,         // counter of active envelopes
+    I2C_UPDATE,         // I2C_INTERFACE_C::Update
+    I2C_BUSMUX,         // I2C_INTERFACE_C::BusMux      arg = cluster << 8 | slice
+    I2C_READ16,         // I2C_INTERFACE_C::ReadRegister16  arg = port << 8 | register
+    COUNT
+    };
+
+enum class TRACE_TYPE : uint8_t
+    {
+    BEGIN = 0,
+    END,
+    COUNTER
+    };
+
+typedef struct
+    {
+    uint32_t    Cycles;         // cycle counter of the core it was made on
+    uint8_t     Id;             // TRACE_ID with TRACE_CORE_BIT
+    uint8_t     Type;           // TRACE_TYPE
+    uint16_t    Arg;            // trace point specific argument
+    int32_t     Value;          // counter value
+    } TRACE_RECORD_T;
+
+//#######################################################################
+class TRACE_C
+    {
+private:
+    TRACE_RECORD_T          _Ring[TRACE_DEPTH];
+    std::atomic<uint32_t>   _Head;          // total number of records ever reserved
+    bool                    _Enabled;
+    TRACE_RECORD_T*         _pCrumb;        // breadcrumb ring in RTC memory, nullptr for none
+    volatile uint32_t*      _pCrumbHead;
+
+public:
+         TRACE_C        (void);
+    void Clear          (void);
+    void DumpJSON       (void);
+    void DumpBinary     (void);
+    bool Fetch          (uint32_t index, TRACE_RECORD_T& rec);
+    const char* Name    (uint8_t id);
+
+    void Crumbs (TRACE_RECORD_T* pring, volatile uint32_t* phead)
+        {
+        _pCrumbHead = phead;
+        _pCrumb     = pring;
+        }
+
+    void Enable (bool state)
+        { _Enabled = state; }
+
+    bool IsEnabled (void)
+        { return (_Enabled); }
+
+    uint32_t Count (void)                   // records currently held in the ring
+        {
+        uint32_t head = _Head.load (std::memory_order_relaxed);
+        return (( head < TRACE_DEPTH ) ? head : TRACE_DEPTH);
+        }
+
+    //#######################################################################
+    // Multiple producers are safe.  The slot is reserved with a single
+    // atomic add and filled in place, so nothing is formatted or locked.
+    // Type is marked filling first and stored last, so a dump skips a
+    // record still being written.  Each core has its own cycle counter
+    // so the record carries the core.  The breadcrumb copy is made even with
+    // tracing off.  Its head is not atomic, two cores racing can lose a
+    // point there and nothing worse.
+    //#######################################################################
+    void Record (TRACE_ID id, TRACE_TYPE type, uint16_t arg, int32_t value)
+        {
+        TRACE_RECORD_T rec;
+
+        if ( !_Enabled && _pCrumb == nullptr )
+            return;
+        rec.Cycles = ESP.getCycleCount ();
+        rec.Id     = (uint8_t)id | (( xPortGetCoreID () ) ? TRACE_CORE_BIT : 0);
+        rec.Type   = (uint8_t)type;
+        rec.Arg    = arg;
+        rec.Value  = value;
+        if ( _pCrumb != nullptr )
+            _pCrumb[(*_pCrumbHead)++ & (TRACE_CRUMB_DEPTH - 1)] = rec;
+        if ( _Enabled )
+            {
+            TRACE_RECORD_T& slot = _Ring[_Head.fetch_add (1, std::memory_order_relaxed) & (TRACE_DEPTH - 1)];
+
+            __atomic_store_n (&slot.Type, TRACE_FILLING, __ATOMIC_RELAXED);
+            std::atomic_thread_fence (std::memory_order_release);
+            slot.Cycles = rec.Cycles;
+            slot.Id     = rec.Id;
+            slot.Arg    = rec.Arg;
+            slot.Value  = rec.Value;
+            __atomic_store_n (&slot.Type, rec.Type, __ATOMIC_RELEASE);
+            }
+        }
+    };
+
+//#######################################################################
+extern TRACE_C Tracer;
+
+//#######################################################################
+// Begin and end pair for the life of a scope
+//#######################################################################
+class TRACE_SCOPE_C
+    {
+private:
+    TRACE_ID    _Id;
+    uint16_t    _Arg;
+
+public:
+    TRACE_SCOPE_C (TRACE_ID id, uint16_t arg) : _Id(id), _Arg(arg)
+        { Tracer.Record (_Id, TRACE_TYPE::BEGIN, _Arg, 0); }
+    ~TRACE_SCOPE_C (void)
+        { Tracer.Record (_Id, TRACE_TYPE::END, _Arg, 0); }
+    };
+
+#ifdef TRACE_SYNTH
+#define TRACE_BEGIN(id, arg)        Tracer.Record (TRACE_ID::id, TRACE_TYPE::BEGIN, (arg), 0)
+#define TRACE_END(id, arg)          Tracer.Record (TRACE_ID::id, TRACE_TYPE::END, (arg), 0)
+#define TRACE_COUNTER(id, val)      Tracer.Record (TRACE_ID::id, TRACE_TYPE::COUNTER, 0, (val))
+#define TRACE_SCOPE(id, arg)        TRACE_SCOPE_C _TraceScope (TRACE_ID::id, (arg))
+#else
+#define TRACE_BEGIN(id, arg)
+#define TRACE_END(id, arg)
+#define TRACE_COUNTER(id, val)
+#define TRACE_SCOPE(id, arg)
+#endif
+
@@ -6,6 +6,8 @@
 //#######################################################################
 #include <Arduino.h>
 #include <ZynthTime.h>
+#include <Crumbs.h>
+#include <Recorder.h>
 
 //#######################################################################
     ZYNTH_TIME_C::ZYNTH_TIME_C ()
@@ -18,27 +20,44 @@
     _DeltaTimeMilliAvg = 0.0;
     _LongestTimeMilli  = 0.0;
     _FailAlert         = false;
+    _Replay            = false;
+    _WindowStart       = 0;
+    memset (_Hist, 0, sizeof (_Hist));
+    memset (&_Snapshot, 0, sizeof (_Snapshot));
+    _Snapshot.Version  = ZT_SNAPSHOT_VERSION;
+    _Snapshot.Phases   = (uint16_t)ZPHASE::COUNT;
+    _Snapshot.WindowMs = ZT_WINDOW_DEFAULT;
     }
 
 //#######################################################################
-inline void ZYNTH_TIME_C::TimeDelta (void)
+inline void ZYNTH_TIME_C::Interval (uint32_t usec)
     {
-    static uint64_t strt = 0;       // Starting time for next frame delta calculation
-
-    _RunTime = micros ();
-    _DeltaTimeMicro = (int)(_RunTime - strt);
+    _DeltaTimeMicro = (int)usec;
     _DeltaTimeMilli = MICRO_TO_MILLI (_DeltaTimeMicro);
     if ( _DeltaTimeMilliAvg == 0 )
         _DeltaTimeMilliAvg = _DeltaTimeMilli;
     else
         _DeltaTimeMilliAvg = (_DeltaTimeMilliAvg + _DeltaTimeMilli) / 2;
-    strt = _RunTime;
+    PhaseTime (ZPHASE::LOOP, (uint32_t)_DeltaTimeMicro);
     if ( _DeltaTimeMilli > 210 )     // throw out long serial debug outputs
         return;
     if ( _DeltaTimeMilli > _LongestTimeMilli )
         _LongestTimeMilli = _DeltaTimeMilli;
     }
 
+//#######################################################################
+inline void ZYNTH_TIME_C::TimeDelta (void)
+    {
+    static uint64_t strt = 0;       // Starting time for next frame delta calculation
+
+    _RunTime = micros ();
+    uint32_t usec = _RunTime - strt;
+    strt = _RunTime;
+    REC_POINT (LOOP, 0, 0, (int32_t)usec);
+    Breadcrumbs.LoopTime (usec, (uint32_t)_RunTime);
+    Interval (usec);
+    }
+
 //#######################################################################
 inline bool ZYNTH_TIME_C::TickTime (void)
     {
@@ -78,15 +97,129 @@ inline void ZYNTH_TIME_C::TickState (void)
         digitalWrite (HEARTBEAT_PIN, LOW);      // LED off
     }
 
+//#######################################################################
+void ZYNTH_TIME_C::PhaseTime (ZPHASE phase, uint32_t micro)
+    {
+    ZYNTH_HIST_T& hist = _Hist[(int)phase];
+    int           index;
+
+    if ( micro < ZT_HIST_LINEAR )
+        index = micro;
+    else
+        {
+        int octave = 31 - __builtin_clz (micro);                  // 3 and up
+        int sub    = (micro >> (octave - 2)) & (ZT_HIST_SUB - 1);
+        index = ZT_HIST_LINEAR + ((octave - 3) * ZT_HIST_SUB) + sub;
+        }
+    hist.Bucket[index]++;
+    hist.Count++;
+    if ( micro > hist.Max )
+        hist.Max = micro;
+    }
+
+//#######################################################################
+// Returns the upper bound of the bucket holding the requested permille
+// of the samples, never more than the exact maximum.
+//#######################################################################
+uint32_t ZYNTH_TIME_C::Percentile (ZYNTH_HIST_T& hist, uint32_t permille)
+    {
+    uint64_t target = (((uint64_t)hist.Count * permille) + 999) / 1000;
+    uint64_t sum    = 0;
+
+    if ( hist.Count == 0 )
+        return (0);
+    for ( int z = 0;  z < ZT_HIST_BUCKETS;  z++ )
+        {
+        sum += hist.Bucket[z];
+        if ( sum >= target )
+            {
+            uint32_t upper;
+            if ( z < ZT_HIST_LINEAR )
+                upper = z;
+            else
+                {
+                int octave = ((z - ZT_HIST_LINEAR) / ZT_HIST_SUB) + 3;
+                int sub    = (z - ZT_HIST_LINEAR) % ZT_HIST_SUB;
+                upper = (((uint64_t)(ZT_HIST_SUB + sub + 1)) << (octave - 2)) - 1;
+                }
+            return (( upper < hist.Max ) ? upper : hist.Max);
+            }
+        }
+    return (hist.Max);
+    }
+
+//#######################################################################
+// Close out the current window into the snapshot and start a new one
+//#######################################################################
+void ZYNTH_TIME_C::Rotate (void)
+    {
+    for ( int z = 0;  z < (int)ZPHASE::COUNT;  z++ )
+        {
+        ZYNTH_HIST_T&        hist  = _Hist[z];
+        ZYNTH_PHASE_STATS_T& stats = _Snapshot.Phase[z];
+
+        stats.Count = hist.Count;
+        stats.P50   = Percentile (hist, 500);
+        stats.P99   = Percentile (hist, 990);
+        stats.P999  = Percentile (hist, 999);
+        stats.Max   = hist.Max;
+        }
+    _Snapshot.Sequence++;
+    memset (_Hist, 0, sizeof (_Hist));
+    _WindowStart = _RunTime;
+    }
+
+//#######################################################################
+void ZYNTH_TIME_C::DumpStats (void)
+    {
+    static const char* names[] = { "LOOP", "ENVELOPE", "I2C", "A/D" };
+
+    printf ("\n  Loop timing over %d mSec window #%d (uSec)\n", _Snapshot.WindowMs, _Snapshot.Sequence);
+    printf ("    %-10s %8s %8s %8s %8s %8s\n", "phase", "count", "p50", "p99", "p99.9", "max");
+    for ( int z = 0;  z < (int)ZPHASE::COUNT;  z++ )
+        {
+        ZYNTH_PHASE_STATS_T& stats = _Snapshot.Phase[z];
+        printf ("    %-10s %8u %8u %8u %8u %8u\n", names[z], stats.Count, stats.P50, stats.P99, stats.P999, stats.Max);
+        }
+    }
+
 //#######################################################################
 //#######################################################################
 void ZYNTH_TIME_C::Loop (void)
     {
     TimeDelta ();
+    if ( (_RunTime - _WindowStart) >= MILLI_TO_MICRO ((uint64_t)_Snapshot.WindowMs) )
+        Rotate ();
     if ( TickTime () )
         TickState ();
     }
 
+//#######################################################################
+// Loop () with the interval taken from an event log instead of the
+// clock.  No heartbeat.
+//#######################################################################
+void ZYNTH_TIME_C::Advance (uint32_t usec)
+    {
+    _RunTime += usec;
+    Interval (usec);
+    if ( (_RunTime - _WindowStart) >= MILLI_TO_MICRO ((uint64_t)_Snapshot.WindowMs) )
+        Rotate ();
+    }
+
+//#######################################################################
+// While set Micros () only moves with Advance () so slew and glide step
+// by the logged intervals too.
+//#######################################################################
+void ZYNTH_TIME_C::SetReplay (bool state)
+    {
+    _Replay = state;
+    if ( state )
+        {
+        _RunTime     = 0;
+        _WindowStart = 0;
+        }
+    }
+
 //#######################################################################
 ZYNTH_TIME_C ZyTime;
 
@@ -4,6 +4,7 @@
 // Creator:    markeby
 // Date:       2/11/2026
 //#######################################################################
+#pragma once
 
 //#####################################
 // Usefull multipliers
@@ -17,6 +18,52 @@
 #define HEARTBEAT_PIN       2
 #define BEEP_PIN            15
 
+//#####################################
+// Loop time histogram
+//  - Log bucketed in uSec.  Below 8 uSec every
+//    value has a bucket, above that each octave
+//    is split into 4 buckets (~20% resolution)
+//#####################################
+#define ZT_HIST_LINEAR      8
+#define ZT_HIST_SUB         4
+#define ZT_HIST_BUCKETS     (ZT_HIST_LINEAR + ((32 - 3) * ZT_HIST_SUB))
+#define ZT_WINDOW_DEFAULT   1000        // rolling window length in mSec
+#define ZT_SNAPSHOT_VERSION 1
+
+enum class ZPHASE : uint8_t
+    {
+    LOOP = 0,           // complete loop interval
+    ENVELOPE,           // envelope and LFO processing
+    I2C_FLUSH,          // I2C output updates
+    ATOD,               // A/D polling
+    COUNT
+    };
+
+typedef struct
+    {
+    uint32_t    Count;                      // samples in the window
+    uint32_t    Max;                        // exact maximum in uSec
+    uint32_t    Bucket[ZT_HIST_BUCKETS];
+    } ZYNTH_HIST_T;
+
+typedef struct
+    {
+    uint32_t    Count;                      // samples in the window
+    uint32_t    P50;                        // all times in uSec
+    uint32_t    P99;
+    uint32_t    P999;
+    uint32_t    Max;
+    } ZYNTH_PHASE_STATS_T;
+
+typedef struct                              // compact block suitable for streaming as binary
+    {
+    uint16_t            Version;
+    uint16_t            Phases;
+    uint32_t            WindowMs;
+    uint32_t            Sequence;           // incremented for each completed window
+    ZYNTH_PHASE_STATS_T Phase[(int)ZPHASE::COUNT];
+    } ZYNTH_TIME_SNAPSHOT_T;
+
 //#####################################
 // TIme class
 //#####################################
@@ -29,15 +76,30 @@ private:
     float       _DeltaTimeMilliAvg;         // Average run time in mSec
     float       _LongestTimeMilli;          // longest running loop in mSec
     bool        _FailAlert;                 // true to alert failure mode
+    bool        _Replay;                    // clock runs from Advance () only
 
-    void TimeDelta (void);
-    bool TickTime  (void);
-    void TickState (void);
+    ZYNTH_HIST_T            _Hist[(int)ZPHASE::COUNT];  // current window
+    ZYNTH_TIME_SNAPSHOT_T   _Snapshot;                  // results of last completed window
+    uint64_t                _WindowStart;               // uSec start of current window
+
+    void     Interval   (uint32_t usec);
+    void     TimeDelta  (void);
+    bool     TickTime   (void);
+    void     TickState  (void);
+    void     Rotate     (void);
+    uint32_t Percentile (ZYNTH_HIST_T& hist, uint32_t permille);
 
 public:
         ZYNTH_TIME_C (void);
 
     void Loop (void);                   // looping function for time information
+    void Advance (uint32_t usec);       // Loop () for replay with the interval given
+    void SetReplay (bool state);        // start or end a replay clock from zero
+
+    uint32_t Micros (void)              // micros () or the replay clock for anything stepped by time
+        {
+        return (( _Replay ) ? (uint32_t)_RunTime : micros ());
+        }
 
     uint64_t TotalRunningTime (void)    // return the continues counting clock that starts at zero
         {
@@ -65,6 +127,31 @@ public:
         {
         _FailAlert = state;
         }
+
+    void PhaseTime (ZPHASE phase, uint32_t micro);     // add a sample in uSec to a phase histogram
+
+    void PhaseEnd (ZPHASE phase, uint32_t start)       // add a sample from a micros() start time
+        {
+        PhaseTime (phase, (uint32_t)micros () - start);
+        }
+
+    void SetWindow (uint32_t ms)                        // length of the rolling window in mSec
+        {
+        _Snapshot.WindowMs = ms;
+        }
+
+    bool Snapshot (ZYNTH_TIME_SNAPSHOT_T& snap)         // copy of the last completed window, false if none yet
+        {
+        snap = _Snapshot;
+        return (_Snapshot.Sequence != 0);
+        }
+
+    const ZYNTH_PHASE_STATS_T& PhaseStats (ZPHASE phase)
+        {
+        return (_Snapshot.Phase[(int)phase]);
+        }
+
+    void DumpStats (void);
     };
 
 //#####################################
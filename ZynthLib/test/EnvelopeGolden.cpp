@@ -0,0 +1,305 @@
+//#######################################################################
+// Module:     EnvelopeGolden.cpp
+// Descrption: Host check of the envelope D/A output against golden logs
+// Creator:    markeby
+// Date:       10/19/2026
+//#######################################################################
+//host libraries
+#include <Arduino.h>
+
+//ZynthLib
+#include "I2Cdevices.h"
+#include "ZynthTime.h"
+#include "Envelope.h"
+#include "Recorder.h"
+
+#define GOLD_TOLERANCE      2           // D/A counts a code may move from its golden value
+#define GOLD_RECORDS        16384       // room in the output log of one cell
+#define GOLD_RANGE          4095
+#define GOLD_EPOCH          1000000     // micros () each cell starts from
+#define GOLD_END_MS         420         // instrument time rendered per cell
+
+//#######################################################################
+// Every ADSR setting runs side by side on its own D/A channel in each
+// cell of the grid.  Each sits on or near a threshold in Process ().
+//#######################################################################
+typedef struct
+    {
+    const char* Name;
+    float       Top;
+    float       Bottom;
+    float       Sustain;
+    float       Attack;         // mSec
+    float       Decay;
+    float       Release;
+    } GOLD_ADSR_T;
+
+static const GOLD_ADSR_T Adsr[] =
+    {
+    { "plain",   1.0, 0.0, 0.6, 20.0, 40.0,  60.0 },
+    { "nodecay", 1.0, 0.0, 0.5, 15.0,  5.0,  50.0 },    // decay under 8 mSec holds the peak
+    { "peak",    0.9, 0.1, 0.9, 30.0, 30.0,  40.0 },    // sustain at the top level
+    { "snap",    1.0, 0.0, 0.4,  0.0, 12.0,  15.0 },    // decay and release inside the final step
+    { "slow",    0.8, 0.2, 0.3, 60.0, 80.0, 150.0 },
+    { "edge",    1.0, 0.0, 0.7,  9.0,  8.0,  21.0 },    // right on the no decay and release cut offs
+    };
+
+#define GOLD_ENVELOPES      (int)(sizeof (Adsr) / sizeof (Adsr[0]))
+
+//#######################################################################
+// Loop interval patterns in uSec
+//#######################################################################
+static uint32_t Steady (int, uint32_t&)
+    {
+    return (1000);
+    }
+
+static uint32_t Jitter (int, uint32_t& seed)
+    {
+    seed = (seed * 1103515245) + 12345;
+    return (600 + ((seed >> 16) % 800));
+    }
+
+static uint32_t Stall (int loop, uint32_t&)
+    {
+    return (( (loop % 37) == 36 ) ? 12000 : 1000);      // a long debug print now and then
+    }
+
+static uint32_t Coarse (int loop, uint32_t&)
+    {
+    return (4000 + ((loop % 3) * 500));
+    }
+
+typedef struct
+    {
+    const char* Name;
+    uint32_t    (*Interval) (int loop, uint32_t& seed);
+    } GOLD_JITTER_T;
+
+static const GOLD_JITTER_T Pattern[] =
+    {
+    { "steady", Steady },
+    { "jitter", Jitter },
+    { "stall",  Stall  },
+    { "coarse", Coarse },
+    };
+
+static const char* DamperName[] = { "off", "normal", "invert" };
+
+static I2C_LOCATION_T Boards[] =
+    {
+    { -1, 0, 0x60, 8, 0, 0, "Golden D/A", 0, 0, I2C_PRIORITY::AUTO, 0, I2C_DRIVER::AUTO },
+    { -1, -1, -1, 0, 0, 0, "", 0, 0, I2C_PRIORITY::AUTO, 0, I2C_DRIVER::AUTO },
+    };
+
+static uint8_t UseCount[GOLD_ENVELOPES];
+
+//#######################################################################
+// True once when the time passes ms
+//#######################################################################
+static bool At (uint32_t prev, uint32_t now, uint32_t ms)
+    {
+    return (prev < ms * 1000 && now >= ms * 1000);
+    }
+
+//#######################################################################
+// Every envelope set up for a cell and at rest with the pedal down
+//#######################################################################
+static void Rest (DAMPER damper, bool dual)
+    {
+    for ( int z = 0;  z < GOLD_ENVELOPES;  z++ )
+        {
+        ENVELOPE_C*  pe = EnvelopeGenerator.Get (z);
+        ENV_PARAMS_T params;
+
+        params.Top         = Adsr[z].Top;
+        params.Bottom      = Adsr[z].Bottom;
+        params.Sustain     = Adsr[z].Sustain;
+        params.AttackTime  = Adsr[z].Attack;
+        params.DecayTime   = Adsr[z].Decay;
+        params.ReleaseTime = Adsr[z].Release;
+        params.Expression  = 1.0;
+        params.ScaleLFO    = 0.2;
+        params.DamperMode  = (uint8_t)damper;
+        params.UseSoftLFO  = false;
+        params.DualUse     = dual;
+        params.Spare       = 0;
+        pe->SetParams (params);
+        pe->Damper (true);
+        pe->Clear ();
+        }
+    HostSetMicros (GOLD_EPOCH);
+    ZyTime.Loop ();                                     // interval since the last cell is not logged
+    EnvelopeGenerator.Loop ();
+    }
+
+//#######################################################################
+// One cell of the grid into the event recorder, keeping the kinds of
+// record in mask.  Every envelope starts at rest, plays a note, has the
+// pedal lifted part way through the release and two of them play a
+// short second note.
+//#######################################################################
+static void Render (const GOLD_JITTER_T& pattern, DAMPER damper, bool dual, uint32_t mask)
+    {
+    uint32_t now  = 0;
+    uint32_t prev = 0;
+    uint32_t seed = 12345;
+
+    Rest (damper, dual);
+    EventRecorder.Start (GOLD_RECORDS, mask);
+    for ( int loop = 0;  now < GOLD_END_MS * 1000;  loop++ )
+        {
+        prev = now;
+        now += pattern.Interval (loop, seed);
+        HostSetMicros (GOLD_EPOCH + now);
+        ZyTime.Loop ();
+
+        for ( int z = 0;  z < GOLD_ENVELOPES;  z++ )
+            {
+            ENVELOPE_C* pe = EnvelopeGenerator.Get (z);
+
+            if ( At (prev, now, 5) )
+                pe->Start ();
+            if ( dual && At (prev, now, 100) )
+                pe->SetModulationLevel (0.25);
+            if ( At (prev, now, 200) )
+                pe->End ();
+            if ( At (prev, now, 240) )
+                pe->Damper (false);
+            if ( dual && At (prev, now, 300) )
+                pe->SetModulationLevel (0.75);
+            if ( (z == 0 || z == 3) && At (prev, now, 330) )
+                pe->Start ();
+            if ( (z == 0 || z == 3) && At (prev, now, 380) )
+                pe->End ();
+            }
+        EnvelopeGenerator.Loop ();
+        }
+    EventRecorder.Stop ();
+    }
+
+//#######################################################################
+// A copy of the log just recorded, delete[] when done
+//#######################################################################
+static uint8_t* Keep (size_t& size)
+    {
+    uint8_t* plog = new uint8_t[EventRecorder.Size ()];
+
+    size = EventRecorder.Size ();
+    memcpy (plog, EventRecorder.Log (), size);
+    return (plog);
+    }
+
+//#######################################################################
+// A cell recorded from its inputs and replayed from rest has to put out
+// exactly what rendering it directly did.
+//#######################################################################
+static bool RoundTrip (const GOLD_JITTER_T& pattern, DAMPER damper, bool dual, REC_REPLAY_T& stats, REC_COMPARE_T& result)
+    {
+    size_t   isize;
+    size_t   dsize;
+    bool     ok;
+
+    Render (pattern, damper, dual, REC_INPUTS);
+    uint8_t* pinput = Keep (isize);
+    Render (pattern, damper, dual, REC_OUTPUTS);
+    uint8_t* pdirect = Keep (dsize);
+
+    Rest (damper, dual);
+    ok = EventRecorder.Replay (pinput, isize, GOLD_RECORDS, stats)
+      && EventRecorder.Compare (pdirect, dsize, EventRecorder.Log (), EventRecorder.Size (), 0, result);
+    delete[] pinput;
+    delete[] pdirect;
+    return (ok);
+    }
+
+//#######################################################################
+// envgolden [-w] [directory]
+//   Renders every cell and compares it with its golden log, then checks
+//   one cell recorded from its inputs and replayed against rendering it
+//   directly.  With -w writes the golden logs again.  Exit status is 1
+//   on any difference.
+//#######################################################################
+int main (int argc, char** argv)
+    {
+    bool        write = ( argc > 1 && strcmp (argv[1], "-w") == 0 );
+    const char* dir   = ( argc > (write ? 2 : 1) ) ? argv[write ? 2 : 1] : "golden";
+    int         cells = 0;
+    int         fails = 0;
+
+    if ( I2cDevices.Begin (Boards, I2C_SPEED_400) < 0 )
+        {
+        printf ("No simulated D/A board\n");
+        return (1);
+        }
+    I2cDevices.SetOffline (true);
+    for ( int z = 0;  z < GOLD_ENVELOPES;  z++ )
+        EnvelopeGenerator.NewADSR (z, Adsr[z].Name, z, GOLD_RANGE, UseCount[z]);
+
+    for ( const GOLD_JITTER_T& pattern : Pattern )
+        {
+        for ( int zd = (int)DAMPER::OFF;  zd < (int)DAMPER::MAX;  zd++ )
+            {
+            for ( int dual = 0;  dual < 2;  dual++ )
+                {
+                char path[256];
+
+                snprintf (path, sizeof (path), "%s/%s-%s-%s.zrec", dir, pattern.Name, DamperName[zd], ( dual ) ? "dual" : "single");
+                Render (pattern, (DAMPER)zd, dual, REC_OUTPUTS);
+                cells++;
+                if ( write )
+                    {
+                    if ( !EventRecorder.Save (path) )
+                        {
+                        printf ("  unable to write %s\n", path);
+                        fails++;
+                        }
+                    continue;
+                    }
+
+                size_t        size;
+                uint8_t*      pgold = EventRecorder.Load (path, size);
+                REC_COMPARE_T result;
+
+                if ( pgold == nullptr )
+                    {
+                    printf ("  MISSING  %s\n", path);
+                    fails++;
+                    continue;
+                    }
+                bool ok = EventRecorder.Compare (pgold, size, EventRecorder.Log (), EventRecorder.Size (), GOLD_TOLERANCE, result);
+                delete[] pgold;
+                if ( ok )
+                    printf ("  pass     %-40s %4u loops %5u codes  max error %u\n", path, result.Loops, result.Codes, result.MaxError);
+                else
+                    {
+                    printf ("  FAIL     %-40s %4u loops %5u codes  max error %u  %u over from loop %u device %d%s\n", path, result.Loops, result.Codes,
+                            result.MaxError, result.Over, result.FirstLoop, result.FirstDevice, ( result.LoopsMatch ) ? "" : "  loop count differs");
+                    fails++;
+                    }
+                }
+            }
+        }
+
+    if ( !write )
+        {
+        REC_REPLAY_T  stats;
+        REC_COMPARE_T result;
+
+        cells++;
+        if ( RoundTrip (Pattern[1], DAMPER::NORMAL, true, stats, result) )
+            printf ("  pass     %-40s %4u loops %5u codes  %u records replayed\n", "round trip jitter-normal-dual", result.Loops, result.Codes, stats.Records);
+        else
+            {
+            printf ("  FAIL     %-40s %4u loops %5u codes  max error %u  %u over from loop %u device %d%s\n", "round trip jitter-normal-dual", result.Loops, result.Codes,
+                    result.MaxError, result.Over, result.FirstLoop, result.FirstDevice, ( result.LoopsMatch ) ? "" : "  loop count differs");
+            fails++;
+            }
+        }
+
+    if ( write )
+        printf ("%d golden logs written to %s\n", cells - fails, dir);
+    else
+        printf ("%d of %d cells match within %d counts\n", cells - fails, cells, GOLD_TOLERANCE);
+    return (( fails ) ? 1 : 0);
+    }
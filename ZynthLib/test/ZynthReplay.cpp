@@ -0,0 +1,113 @@
+//#######################################################################
+// Module:     ZynthReplay.cpp
+// Descrption: Host replay of an event log saved off the instrument
+// Creator:    markeby
+// Date:       10/19/2026
+//#######################################################################
+//host libraries
+#include <Arduino.h>
+
+//ZynthLib
+#include "I2Cdevices.h"
+#include "Envelope.h"
+#include "Recorder.h"
+
+#define REPLAY_RECORDS      65536       // default room in the output log
+#define REPLAY_PER_BOARD    8           // D/A channels on each simulated board
+#define REPLAY_BOARDS       8
+
+static I2C_LOCATION_T Boards[REPLAY_BOARDS + 1];
+
+//#######################################################################
+// Simulated D/A boards enough to reach every device the log's envelopes
+// write to.  Nothing is sent since the bus is offline during a replay.
+//#######################################################################
+static bool MakeBoards (const uint8_t* plog, size_t size)
+    {
+    const REC_HEADER_T*   phdr = (const REC_HEADER_T*)plog;
+    const REC_ENVELOPE_T* penv = (const REC_ENVELOPE_T*)(phdr + 1);
+    int                   top  = 0;
+    int                   count;
+
+    if ( size < sizeof (REC_HEADER_T) || size < sizeof (REC_HEADER_T) + phdr->Envelopes * sizeof (REC_ENVELOPE_T) )
+        {
+        printf ("Not an event log\n");
+        return (false);
+        }
+    for ( int z = 0;  z < phdr->Envelopes;  z++, penv++ )
+        top = max (top, penv->Device + 1);
+    count = max (1, (top + REPLAY_PER_BOARD - 1) / REPLAY_PER_BOARD);
+    if ( count > REPLAY_BOARDS )
+        {
+        printf ("Log writes device %d, only %d can be simulated\n", top - 1, REPLAY_BOARDS * REPLAY_PER_BOARD);
+        return (false);
+        }
+    for ( int z = 0;  z < count;  z++ )
+        Boards[z] = { -1, 0, 0x60 + z, REPLAY_PER_BOARD, 0, 0, "Replay D/A", 0, 0, I2C_PRIORITY::AUTO, 0, I2C_DRIVER::AUTO };
+    Boards[count] = { -1, -1, -1, 0, 0, 0, "", 0, 0, I2C_PRIORITY::AUTO, 0, I2C_DRIVER::AUTO };
+    return (true);
+    }
+
+//#######################################################################
+// Every D/A write of the replay with the envelope loop it came from
+//#######################################################################
+static void DumpWrites (const uint8_t* plog)
+    {
+    const REC_HEADER_T* phdr = (const REC_HEADER_T*)plog;
+    const REC_RECORD_T* prec = (const REC_RECORD_T*)(plog + sizeof (REC_HEADER_T) + phdr->Envelopes * sizeof (REC_ENVELOPE_T));
+    uint32_t            loop = 0;
+
+    printf ("   loop  device   code\n");
+    for ( uint32_t z = 0;  z < phdr->Count;  z++, prec++ )
+        {
+        if ( prec->Id == (uint8_t)REC_ID::ENV_LOOP )
+            loop++;
+        else if ( prec->Id == (uint8_t)REC_ID::DTOA )
+            printf ("%7u  %6u  %5d\n", loop, prec->Arg, prec->I);
+        }
+    }
+
+//#######################################################################
+// zreplay log [records]
+//   Replays a log recorded with REC_INPUTS, prints the D/A writes it
+//   makes and the replay statistics.  records is the room in the
+//   output log.  Exit status is 1 if the log cannot be replayed.
+//#######################################################################
+int main (int argc, char** argv)
+    {
+    uint32_t     records = ( argc > 2 ) ? strtoul (argv[2], nullptr, 0) : REPLAY_RECORDS;
+    size_t       size;
+    uint8_t*     plog;
+    REC_REPLAY_T stats;
+
+    if ( argc < 2 )
+        {
+        printf ("usage: zreplay log [records]\n");
+        return (1);
+        }
+    plog = EventRecorder.Load (argv[1], size);
+    if ( plog == nullptr )
+        {
+        printf ("Unable to read %s\n", argv[1]);
+        return (1);
+        }
+    if ( !MakeBoards (plog, size) || I2cDevices.Begin (Boards, I2C_SPEED_400) < 0 )
+        {
+        delete[] plog;
+        return (1);
+        }
+    I2cDevices.SetOffline (true);
+
+    bool ok = EventRecorder.Replay (plog, size, records, stats);
+    delete[] plog;
+    if ( !ok )
+        {
+        printf ("Unable to replay %s\n", argv[1]);
+        return (1);
+        }
+    DumpWrites (EventRecorder.Log ());
+    // wall and loop times stay 0 here, the stub clock only moves when a test moves it
+    printf ("\n%u records  %u loops  %u writes%s\n", stats.Records, stats.Loops, stats.Writes, ( EventRecorder.IsFull () ) ? "  output log full" : "");
+    printf ("%.3f sec simulated in %u uSec  loop max %u uSec  average %.1f uSec\n", stats.Simulated / 1000000.0, stats.Wall, stats.LoopMax, stats.LoopAvg);
+    return (0);
+    }
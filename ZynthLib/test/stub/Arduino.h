@@ -0,0 +1,138 @@
+//#######################################################################
+// Module:     Arduino.h
+// Descrption: Host stand in for the Arduino and FreeRTOS calls ZynthLib
+//             uses, enough to run the envelope engine off the instrument
+// Creator:    markeby
+// Date:       10/19/2026
+//#######################################################################
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string>
+#include <algorithm>
+
+using std::min;
+using std::max;
+
+typedef uint8_t         byte;
+typedef unsigned short  ushort;
+
+#define HIGH            1
+#define LOW             0
+#define OUTPUT          1
+#define INPUT           0
+#define INPUT_PULLUP    2
+#define FALLING         2
+#define IRAM_ATTR
+#define RTC_NOINIT_ATTR
+#ifndef __FILE_NAME__
+#define __FILE_NAME__   __FILE__
+#endif
+
+#define bitSet(value, bit)              ((value) |= (1UL << (bit)))
+#define bitClear(value, bit)            ((value) &= ~(1UL << (bit)))
+#define bitRead(value, bit)             (((value) >> (bit)) & 0x01)
+#define bitWrite(value, bit, bitvalue)  ((bitvalue) ? bitSet(value, bit) : bitClear(value, bit))
+
+//#######################################################################
+class String
+    {
+public:
+    std::string s;
+
+    String (void)                       {}
+    String (const char* c)              : s(c ? c : "") {}
+    String (const char* c, unsigned n)  : s(c, n) {}
+    String (int v)                      : s(std::to_string (v)) {}
+    String (unsigned v)                 : s(std::to_string (v)) {}
+    String (long v)                     : s(std::to_string (v)) {}
+    String (unsigned long v)            : s(std::to_string (v)) {}
+    String (float v)                    : s(std::to_string (v)) {}
+
+    String operator+ (const String& o) const            { String r; r.s = s + o.s; return (r); }
+    friend String operator+ (const char* a, const String& b)   { String r; r.s = std::string (a) + b.s; return (r); }
+    String& operator+= (const String& o)                { s += o.s; return (*this); }
+    String& operator+= (const char* o)                  { s += o; return (*this); }
+    const char* c_str (void) const                      { return (s.c_str ()); }
+    unsigned length (void) const                        { return (s.size ()); }
+    };
+
+//#######################################################################
+class HardwareSerial
+    {
+public:
+    int    available (void)                             { return (0); }
+    int    read (void)                                  { return (0); }
+    size_t write (const uint8_t*, size_t n)             { return (n); }
+    size_t write (uint8_t)                              { return (1); }
+    size_t print (const char* s)                        { return (printf ("%s", s)); }
+    size_t println (const char* s)                      { return (printf ("%s\n", s)); }
+    int    availableForWrite (void)                     { return (128); }
+    void   flush (void)                                 {}
+    };
+extern HardwareSerial Serial;
+
+//#######################################################################
+class EspClass
+    {
+public:
+    uint32_t getCycleCount (void);
+    uint32_t getCpuFreqMHz (void)                       { return (240); }
+    };
+extern EspClass ESP;
+
+//#######################################################################
+// Time only moves when the test moves it
+//#######################################################################
+unsigned long micros             (void);
+unsigned long millis             (void);
+void          HostSetMicros      (unsigned long usec);
+void          delay              (unsigned long ms);
+void          delayMicroseconds  (unsigned usec);
+
+void pinMode                (int pin, int mode);
+void digitalWrite           (int pin, int state);
+int  digitalRead            (int pin);
+void attachInterrupt        (int pin, void (*isr)(void), int mode);
+int  digitalPinToInterrupt  (int pin);
+
+typedef enum { ESP_RST_UNKNOWN, ESP_RST_POWERON, ESP_RST_EXT, ESP_RST_SW, ESP_RST_PANIC, ESP_RST_INT_WDT,
+               ESP_RST_TASK_WDT, ESP_RST_WDT, ESP_RST_DEEPSLEEP, ESP_RST_BROWNOUT, ESP_RST_SDIO } esp_reset_reason_t;
+esp_reset_reason_t esp_reset_reason     (void);
+uint32_t           esp_cpu_get_cycle_count (void);
+uint32_t           getCpuFrequencyMhz   (void);
+
+//#######################################################################
+// FreeRTOS.  No task is ever started so every bus flushes inline.
+//#######################################################################
+typedef void*       TaskHandle_t;
+typedef void*       SemaphoreHandle_t;
+typedef int         BaseType_t;
+typedef uint32_t    TickType_t;
+typedef struct { int x; } portMUX_TYPE;
+
+#define pdMS_TO_TICKS(x)                (x)
+#define portMAX_DELAY                   0xFFFFFFFF
+#define tskIDLE_PRIORITY                0
+#define pdTRUE                          1
+#define pdFALSE                         0
+#define pdPASS                          1
+#define portMUX_INITIALIZER_UNLOCKED    {0}
+#define portENTER_CRITICAL(m)           (void)(m)
+#define portEXIT_CRITICAL(m)            (void)(m)
+
+BaseType_t        xTaskCreatePinnedToCore   (void (*task)(void*), const char* name, uint32_t stack, void* arg, unsigned prio, TaskHandle_t* ptask, int core);
+BaseType_t        xTaskCreate               (void (*task)(void*), const char* name, uint32_t stack, void* arg, unsigned prio, TaskHandle_t* ptask);
+void              vTaskDelay                (TickType_t ticks);
+void              vTaskDelete               (TaskHandle_t task);
+uint32_t          ulTaskNotifyTake          (BaseType_t clear, TickType_t ticks);
+void              xTaskNotifyGive           (TaskHandle_t task);
+TaskHandle_t      xTaskGetCurrentTaskHandle (void);
+BaseType_t        xPortGetCoreID            (void);
+SemaphoreHandle_t xSemaphoreCreateMutex     (void);
+BaseType_t        xSemaphoreTake            (SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t        xSemaphoreGive            (SemaphoreHandle_t sem);
@@ -0,0 +1,20 @@
+//#######################################################################
+// Module:     Streaming.h
+// Descrption: Host stand in for the Serial << operators
+// Creator:    markeby
+// Date:       10/19/2026
+//#######################################################################
+#pragma once
+#include <Arduino.h>
+
+enum _EndLineCode { endl };
+
+inline HardwareSerial& operator<< (HardwareSerial& s, const char* v)    { printf ("%s", v);           return (s); }
+inline HardwareSerial& operator<< (HardwareSerial& s, char* v)          { printf ("%s", v);           return (s); }
+inline HardwareSerial& operator<< (HardwareSerial& s, const String& v)  { printf ("%s", v.c_str ());  return (s); }
+inline HardwareSerial& operator<< (HardwareSerial& s, long long v)      { printf ("%lld", v);         return (s); }
+inline HardwareSerial& operator<< (HardwareSerial& s, int v)            { printf ("%d", v);           return (s); }
+inline HardwareSerial& operator<< (HardwareSerial& s, unsigned v)       { printf ("%u", v);           return (s); }
+inline HardwareSerial& operator<< (HardwareSerial& s, unsigned long v)  { printf ("%lu", v);          return (s); }
+inline HardwareSerial& operator<< (HardwareSerial& s, double v)         { printf ("%f", v);           return (s); }
+inline HardwareSerial& operator<< (HardwareSerial& s, _EndLineCode)     { printf ("\n");              return (s); }
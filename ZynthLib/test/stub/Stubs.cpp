@@ -0,0 +1,73 @@
+//#######################################################################
+// Module:     Stubs.cpp
+// Descrption: Host stand in for the Arduino and FreeRTOS calls ZynthLib
+//             uses, enough to run the envelope engine off the instrument
+// Creator:    markeby
+// Date:       10/19/2026
+//#######################################################################
+//host libraries
+#include <Arduino.h>
+#include <Wire.h>
+#include <esp_timer.h>
+
+HardwareSerial  Serial;
+TwoWire         Wire, Wire1;
+EspClass        ESP;
+
+static unsigned long HostMicros = 0;
+
+//#######################################################################
+// Time only moves when the test moves it
+//#######################################################################
+unsigned long micros ()                         { return (HostMicros); }
+unsigned long millis ()                         { return (HostMicros / 1000); }
+void HostSetMicros (unsigned long usec)         { HostMicros = usec; }
+void delay (unsigned long ms)                   { HostMicros += ms * 1000; }
+void delayMicroseconds (unsigned usec)          { HostMicros += usec; }
+uint32_t EspClass::getCycleCount ()             { return (HostMicros * 240); }
+uint32_t esp_cpu_get_cycle_count ()             { return (HostMicros * 240); }
+uint32_t getCpuFrequencyMhz ()                  { return (240); }
+esp_reset_reason_t esp_reset_reason ()          { return (ESP_RST_POWERON); }
+
+//#######################################################################
+void pinMode (int, int)                                             {}
+void digitalWrite (int, int)                                        {}
+int  digitalRead (int)                                              { return (0); }
+void attachInterrupt (int, void (*)(void), int)                     {}
+int  digitalPinToInterrupt (int pin)                                { return (pin); }
+
+//#######################################################################
+// No task is ever started so every bus flushes inline
+//#######################################################################
+BaseType_t xTaskCreatePinnedToCore (void (*)(void*), const char*, uint32_t, void*, unsigned, TaskHandle_t* ptask, int)
+    {
+    *ptask = nullptr;
+    return (pdPASS);
+    }
+
+BaseType_t xTaskCreate (void (*)(void*), const char*, uint32_t, void*, unsigned, TaskHandle_t* ptask)
+    {
+    *ptask = nullptr;
+    return (pdPASS);
+    }
+
+void              vTaskDelay (TickType_t)                                   {}
+void              vTaskDelete (TaskHandle_t)                                {}
+uint32_t          ulTaskNotifyTake (BaseType_t, TickType_t)                 { return (1); }
+void              xTaskNotifyGive (TaskHandle_t)                            {}
+TaskHandle_t      xTaskGetCurrentTaskHandle ()                              { return (nullptr); }
+BaseType_t        xPortGetCoreID ()                                         { return (1); }
+SemaphoreHandle_t xSemaphoreCreateMutex ()                                  { return ((SemaphoreHandle_t)1); }
+BaseType_t        xSemaphoreTake (SemaphoreHandle_t, TickType_t)            { return (pdTRUE); }
+BaseType_t        xSemaphoreGive (SemaphoreHandle_t)                        { return (pdTRUE); }
+
+//#######################################################################
+esp_err_t esp_timer_create (const esp_timer_create_args_t*, esp_timer_handle_t* phandle)
+    {
+    *phandle = nullptr;
+    return (ESP_OK);
+    }
+
+esp_err_t esp_timer_start_once (esp_timer_handle_t, uint64_t)             { return (ESP_OK); }
+esp_err_t esp_timer_stop (esp_timer_handle_t)                              { return (ESP_OK); }
+int64_t   esp_timer_get_time ()                                            { return (HostMicros); }
@@ -0,0 +1,27 @@
+//#######################################################################
+// Module:     Wire.h
+// Descrption: Host stand in for the I2C controller.  Every board answers
+//             and nothing is sent anywhere.
+// Creator:    markeby
+// Date:       10/19/2026
+//#######################################################################
+#pragma once
+#include <Arduino.h>
+
+class TwoWire
+    {
+public:
+    TwoWire (uint8_t = 0)                               {}
+    bool    begin (void)                                { return (true); }
+    bool    begin (int, int, uint32_t = 0)              { return (true); }
+    bool    setClock (uint32_t)                         { return (true); }
+    void    beginTransmission (uint16_t)                {}
+    uint8_t endTransmission (bool = true)               { return (0); }
+    size_t  write (uint8_t)                             { return (1); }
+    size_t  write (const uint8_t*, size_t n)            { return (n); }
+    size_t  requestFrom (uint8_t, uint8_t n, bool = true)   { return (n); }
+    int     available (void)                            { return (0); }
+    int     read (void)                                 { return (0); }
+    };
+
+extern TwoWire Wire, Wire1;
@@ -0,0 +1,7 @@
+//#######################################################################
+// Module:     esp_debug_helpers.h
+// Descrption: Host stand in, nothing from it is used off the instrument
+// Creator:    markeby
+// Date:       10/19/2026
+//#######################################################################
+#pragma once
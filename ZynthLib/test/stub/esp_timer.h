@@ -0,0 +1,31 @@
+//#######################################################################
+// Module:     esp_timer.h
+// Descrption: Host stand in for the ESP-IDF high resolution timer
+// Creator:    markeby
+// Date:       10/19/2026
+//#######################################################################
+#pragma once
+#include <stdint.h>
+
+typedef int     esp_err_t;
+#ifndef ESP_OK
+#define ESP_OK  0
+#endif
+
+typedef void*   esp_timer_handle_t;
+typedef void    (*esp_timer_cb_t)(void* arg);
+typedef enum    { ESP_TIMER_TASK } esp_timer_dispatch_t;
+
+typedef struct
+    {
+    esp_timer_cb_t          callback;
+    void*                   arg;
+    esp_timer_dispatch_t    dispatch_method;
+    const char*             name;
+    bool                    skip_unhandled_events;
+    } esp_timer_create_args_t;
+
+esp_err_t esp_timer_create      (const esp_timer_create_args_t* args, esp_timer_handle_t* phandle);
+esp_err_t esp_timer_start_once  (esp_timer_handle_t handle, uint64_t usec);
+esp_err_t esp_timer_stop        (esp_timer_handle_t handle);
+int64_t   esp_timer_get_time    (void);